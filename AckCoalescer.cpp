@@ -0,0 +1,284 @@
+//
+//  AckCoalescer.cpp
+//  ProcessorNode
+//
+
+#include <algorithm>
+
+#include <g3log/g3log.hpp>
+
+#include <ProcessorNode/AckCoalescer.h>
+
+namespace OHARBase {
+
+   const std::string AckCoalescer::TAG{"AckCoalescer "};
+   /** An ack is sent at the latest when this many packages have arrived from a sender since the previous ack. */
+   static const std::size_t ACK_EVERY{256};
+   /** How many packages above the missing ones are remembered per sender. Packages beyond this are
+    not acknowledged until the missing ones arrive, so the sender resends them. */
+   static const std::size_t MAX_OUT_OF_ORDER{8192};
+   /** How many ranges above the cumulative sequence number one ack contains at most. */
+   static const std::size_t MAX_RANGES{16};
+   /** A sender with no packages acknowledged for this long gets no share of the credit, and is forgotten
+    unless it waits for credit. */
+   static const std::chrono::seconds ORIGIN_IDLE{30};
+
+   /**
+    Converts the ack to the payload of an ack package.
+    @return The payload as a JSON string.
+    */
+   std::string SequenceAck::toPayload() const {
+      nlohmann::json j{{"stream", stream}, {"cumulative", cumulative}};
+      if (!ranges.empty()) {
+         j["ranges"] = ranges;
+      }
+      if (credit >= 0) {
+         j["credit"] = credit;
+      }
+      return j.dump();
+   }
+
+   /**
+    Reads the ack from the payload of an ack package.
+    @param payload The payload of the ack package.
+    @return Returns false if the payload is not a sequence ack, e.g. the "ack" of a single package.
+    */
+   bool SequenceAck::fromPayload(const std::string & payload) {
+      if (payload.empty() || payload.front() != '{') {
+         return false;
+      }
+      try {
+         nlohmann::json j = nlohmann::json::parse(payload);
+         stream = j.at("stream").get<std::uint32_t>();
+         cumulative = j.at("cumulative").get<std::uint64_t>();
+         ranges.clear();
+         if (j.find("ranges") != j.end()) {
+            ranges = j["ranges"].get<std::vector<std::pair<std::uint64_t, std::uint64_t>>>();
+         }
+         credit = -1;
+         if (j.find("credit") != j.end()) {
+            credit = j["credit"].get<std::int64_t>();
+         }
+         return true;
+      } catch (const std::exception & e) {
+         LOG(WARNING) << "Invalid sequence ack " << payload << ": " << e.what();
+      }
+      return false;
+   }
+
+   /**
+    Creates the coalescer with no senders.
+    */
+   AckCoalescer::AckCoalescer()
+   : pendingOrigins(0), mostUnacknowledged(0), starvedOrigins(0)
+   {
+   }
+
+   /**
+    Records a received package.
+    @param origin The sender of the package.
+    @param stream The stream of the package.
+    @param sequence The sequence number of the package.
+    @param base The lowest sequence number the sender still waits the ack for, zero if not known. The packages
+    below it are taken as arrived, since the sender has had them acknowledged or has given them up, so that a
+    package which will never arrive does not keep the packages above it waiting.
+    @return Whether the package is new or has arrived before.
+    */
+   AckCoalescer::Arrival AckCoalescer::received(const boost::asio::ip::udp::endpoint & origin, std::uint32_t stream, std::uint64_t sequence, std::uint64_t base) {
+      auto found = origins.find(origin);
+      if (found == origins.end()) {
+         found = origins.emplace(origin, Origin{stream, 0, std::set<std::uint64_t>(), 0, false, std::chrono::steady_clock::now()}).first;
+      }
+      Origin & from = found->second;
+      if (from.stream != stream) {
+         LOG(INFO) << TAG << "New stream " << stream << " from " << origin;
+         from.stream = stream;
+         from.cumulative = 0;
+         from.above.clear();
+      }
+      if (base > from.cumulative + 1) {
+         from.cumulative = base - 1;
+         from.above.erase(from.above.begin(), from.above.upper_bound(from.cumulative));
+         while (!from.above.empty() && *from.above.begin() == from.cumulative + 1) {
+            from.cumulative++;
+            from.above.erase(from.above.begin());
+         }
+      }
+      Arrival arrival = New;
+      if (sequence <= from.cumulative || from.above.count(sequence) > 0) {
+         arrival = Duplicate;
+      } else if (sequence == from.cumulative + 1) {
+         from.cumulative++;
+         while (!from.above.empty() && *from.above.begin() == from.cumulative + 1) {
+            from.cumulative++;
+            from.above.erase(from.above.begin());
+         }
+      } else if (from.above.size() < MAX_OUT_OF_ORDER) {
+         from.above.insert(sequence);
+      } else {
+         // Not remembered, so it would be taken as new again when resent.
+         arrival = Overflow;
+      }
+      // Duplicates are acknowledged too, since the sender has evidently missed the ack.
+      if (from.unacknowledged++ == 0) {
+         pendingOrigins++;
+      }
+      mostUnacknowledged = std::max(mostUnacknowledged, from.unacknowledged);
+      return arrival;
+   }
+
+   /**
+    Use to query if a package has already arrived, without recording it.
+    @param origin The sender of the package.
+    @param stream The stream of the package.
+    @param sequence The sequence number of the package.
+    @return Returns true if the package has arrived before.
+    */
+   bool AckCoalescer::hasArrived(const boost::asio::ip::udp::endpoint & origin, std::uint32_t stream, std::uint64_t sequence) const {
+      auto found = origins.find(origin);
+      if (found == origins.end() || found->second.stream != stream) {
+         return false;
+      }
+      const Origin & from = found->second;
+      return sequence <= from.cumulative || from.above.count(sequence) > 0;
+   }
+
+   /**
+    Use to query if so many packages have arrived from a sender that the acks should be sent
+    without waiting for the delay.
+    @return Returns true if the acks should be sent now.
+    */
+   bool AckCoalescer::shouldAckNow() const {
+      return mostUnacknowledged >= ACK_EVERY;
+   }
+
+   /**
+    Use to query if there are packages not acknowledged yet.
+    @return Returns true if acks should be sent.
+    */
+   bool AckCoalescer::hasPendingAcks() const {
+      return pendingOrigins > 0;
+   }
+
+   /**
+    Builds one ack package to each sender with packages not acknowledged yet.
+    @param acks The ack packages are appended to this vector.
+    @param freeSlots How many packages the input queue has space for, shared evenly between the senders
+    active recently as their credit. With some space, each sender gets at least one package of credit.
+    If negative, the acks give no credit and the senders are not limited.
+    */
+   void AckCoalescer::takeAcks(std::vector<Package> & acks, std::int64_t freeSlots) {
+      if (pendingOrigins == 0) {
+         return;
+      }
+      const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+      forgetIdleOrigins(now);
+      std::int64_t active = 0;
+      for (const auto & item : origins) {
+         if (item.second.unacknowledged > 0 || now - item.second.lastActive < ORIGIN_IDLE) {
+            active++;
+         }
+      }
+      // The remainder of the division is handed out one package at a time.
+      std::int64_t share = 0;
+      std::int64_t remainder = 0;
+      if (freeSlots > 0) {
+         share = freeSlots / active;
+         remainder = freeSlots % active;
+      }
+      for (auto & item : origins) {
+         Origin & from = item.second;
+         if (from.unacknowledged == 0) {
+            continue;
+         }
+         std::int64_t credit = freeSlots < 0 ? -1 : 0;
+         if (freeSlots > 0) {
+            credit = share;
+            if (remainder > 0) {
+               credit++;
+               remainder--;
+            }
+            credit = std::max<std::int64_t>(credit, 1);
+         }
+         from.lastActive = now;
+         SequenceAck ack;
+         ack.stream = from.stream;
+         ack.cumulative = from.cumulative;
+         for (std::uint64_t sequence : from.above) {
+            if (!ack.ranges.empty() && ack.ranges.back().second + 1 == sequence) {
+               ack.ranges.back().second = sequence;
+            } else if (ack.ranges.size() < MAX_RANGES) {
+               ack.ranges.emplace_back(sequence, sequence);
+            } else {
+               break;
+            }
+         }
+         ack.credit = credit;
+         if (credit == 0 && !from.starved) {
+            from.starved = true;
+            starvedOrigins++;
+         } else if (credit != 0 && from.starved) {
+            from.starved = false;
+            starvedOrigins--;
+         }
+         Package package;
+         package.setType(Package::Type::Acknowledgement);
+         package.setPayload(ack.toPayload());
+         package.setDestination(item.first);
+         acks.push_back(std::move(package));
+         from.unacknowledged = 0;
+      }
+      pendingOrigins = 0;
+      mostUnacknowledged = 0;
+   }
+
+   /**
+    Forgets the senders with no packages acknowledged for long, with the packages remembered from them.
+    A sender waiting for credit is kept, so that it is told when there is space again.
+    @param now The current time.
+    */
+   void AckCoalescer::forgetIdleOrigins(std::chrono::steady_clock::time_point now) {
+      for (auto item = origins.begin(); item != origins.end();) {
+         const Origin & from = item->second;
+         if (from.unacknowledged == 0 && !from.starved && now - from.lastActive >= ORIGIN_IDLE) {
+            LOG(INFO) << TAG << "Forgetting idle sender " << item->first;
+            item = origins.erase(item);
+         } else {
+            ++item;
+         }
+      }
+   }
+
+   /**
+    Use to query if some senders were given no credit and wait for an update.
+    @return Returns true if there are senders without credit.
+    */
+   bool AckCoalescer::hasStarvedOrigins() const {
+      return starvedOrigins > 0;
+   }
+
+   /**
+    Marks the senders given no credit to be sent an ack again, with the credit available then.
+    Called when the input queue has space again.
+    */
+   void AckCoalescer::requestCreditUpdates() {
+      for (auto & item : origins) {
+         Origin & from = item.second;
+         if (from.starved && from.unacknowledged == 0) {
+            from.unacknowledged = 1;
+            pendingOrigins++;
+         }
+      }
+   }
+
+   /**
+    Forgets all the senders.
+    */
+   void AckCoalescer::clear() {
+      origins.clear();
+      pendingOrigins = 0;
+      mostUnacknowledged = 0;
+      starvedOrigins = 0;
+   }
+
+} //namespace
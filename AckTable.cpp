@@ -0,0 +1,412 @@
+//
+//  AckTable.cpp
+//  ProcessorNode
+//
+
+#include <algorithm>
+#include <limits>
+
+#include <boost/functional/hash.hpp>
+
+#include <g3log/g3log.hpp>
+
+#include <ProcessorNode/AckTable.h>
+
+namespace OHARBase {
+
+   /** Resolution of the resend deadlines. */
+   static const std::chrono::milliseconds TIMER_TICK{10};
+   /** Default number of resends before a package is given up. */
+   static const int DEFAULT_MAX_RESENDS{8};
+
+   /**
+    Creates an empty table.
+    */
+   AckTable::AckTable()
+   : timers(TIMER_TICK, std::chrono::steady_clock::now()), maxResends(DEFAULT_MAX_RESENDS), streamIds(std::random_device()())
+   {
+   }
+
+   /**
+    Gives the package the next sequence number in the stream of the destination. The number is taken
+    only when the package is added with add(), so a package numbered but not sent, e.g. since it is too
+    large, leaves no gap in the sequence. A package being resent already has a sequence number, and keeps it.
+    The base of the sequence is set to the lowest number still waiting for the ack, or to the number of the
+    package if none is, so the receiver does not wait for the packages given up.
+    @param package The package to number.
+    @param target The destination the package is sent to.
+    */
+   void AckTable::sequence(Package & package, const boost::asio::ip::udp::endpoint & target) {
+      if (package.hasSequence()) {
+         auto stream = streams.find(package.getStream());
+         if (stream != streams.end()) {
+            const std::map<std::uint64_t, std::uint32_t> & pending = stream->second.pending;
+            package.setSequenceBase(pending.empty() ? package.getSequence() : std::min(pending.begin()->first, package.getSequence()));
+         }
+         return;
+      }
+      auto found = targetStreams.find(target);
+      if (found == targetStreams.end()) {
+         // A random id tells the receiver that the numbering starts again, e.g. after a restart.
+         std::uint32_t id = 0;
+         while (id == 0 || streams.count(id) > 0) {
+            id = static_cast<std::uint32_t>(streamIds());
+         }
+         streams.emplace(id, Stream{target, 1, std::map<std::uint64_t, std::uint32_t>(), -1, 0, std::chrono::steady_clock::time_point()});
+         found = targetStreams.emplace(target, id).first;
+      }
+      const Stream & stream = streams[found->second];
+      package.setSequence(found->second, stream.nextSequence);
+      package.setSequenceBase(stream.pending.empty() ? stream.nextSequence : stream.pending.begin()->first);
+   }
+
+   /**
+    Adds a sent package to wait for the ack. If the same package to the same destination is
+    already waiting, this is a resend of it: the send count is incremented and the deadline
+    is moved further with the backoff. A package numbered with sequence() takes its number here.
+    @param package The package sent. If it has a destination, only an ack from that destination is accepted.
+    @param target Where the package was sent to, for measuring the round trip time.
+    @param now The time the package was sent.
+    */
+   void AckTable::add(const Package & package, const boost::asio::ip::udp::endpoint & target, std::chrono::steady_clock::time_point now) {
+      Key key{package.getUuid(), package.hasDestination() ? package.destinationEndpoint() : boost::asio::ip::udp::endpoint()};
+      auto found = index.find(key);
+      std::uint32_t entryIndex;
+      int attempts = 1;
+      if (found != index.end()) {
+         entryIndex = found->second;
+         entries[entryIndex].generation++;
+         attempts = entries[entryIndex].attempts + 1;
+      } else if (!freeEntries.empty()) {
+         entryIndex = freeEntries.back();
+         freeEntries.pop_back();
+         index.emplace(key, entryIndex);
+      } else {
+         entryIndex = static_cast<std::uint32_t>(entries.size());
+         entries.push_back(Entry{Package(boost::uuids::nil_uuid()), boost::asio::ip::udp::endpoint(), now, 0, 0});
+         index.emplace(key, entryIndex);
+      }
+      Entry & entry = entries[entryIndex];
+      if (attempts == 1) {
+         entry.package = package;
+      }
+      entry.target = target;
+      entry.sent = now;
+      entry.attempts = attempts;
+      if (package.hasSequence()) {
+         auto stream = streams.find(package.getStream());
+         if (stream != streams.end()) {
+            stream->second.pending[package.getSequence()] = entryIndex;
+            if (package.getSequence() == stream->second.nextSequence) {
+               stream->second.nextSequence++;
+            }
+         }
+      }
+      const std::chrono::steady_clock::time_point deadline = now + roundTrips[target].timeout(attempts);
+      timers.schedule((static_cast<std::uint64_t>(entry.generation) << 32) | entryIndex, deadline);
+   }
+
+   /**
+    Handles an ack message from the next node. A positive ack removes the package from the table,
+    and if the package was sent only once, the round trip time to the destination is updated.
+    @param ack The ack package. Its uuid is the uuid of the package acknowledged, and its origin the
+    node which acknowledged it.
+    @param now The time the ack arrived.
+    @param uuids If not null, the uuid of the package acknowledged is appended to it.
+    @return Returns true if the package acknowledged was found.
+    */
+   bool AckTable::acknowledge(const Package & ack, std::chrono::steady_clock::time_point now, std::vector<boost::uuids::uuid> * uuids) {
+      // Packages sent to one destination accept the ack from any address, packages sent
+      // to several only from the destination the package was sent to.
+      auto found = index.find(Key{ack.getUuid(), boost::asio::ip::udp::endpoint()});
+      if (found == index.end()) {
+         found = index.find(Key{ack.getUuid(), ack.originEndpoint()});
+         if (found == index.end()) {
+            return false;
+         }
+      }
+      if (ack.getPayloadString() == "ack") {
+         const std::uint32_t entryIndex = found->second;
+         const Entry & entry = entries[entryIndex];
+         // The ack of a resent package may be the ack of any of the sends, so it tells nothing of the round trip.
+         if (entry.attempts == 1) {
+            roundTrips[entry.target].addSample(now - entry.sent);
+         }
+         if (uuids) {
+            uuids->push_back(entry.package.getUuid());
+         }
+         remove(entryIndex);
+      } else {
+         LOG(INFO) << "ackhandling: ack is " << ack.getPayloadString() << " so not acked nor removed from sent.";
+      }
+      return true;
+   }
+
+   /**
+    Handles a coalesced ack from the next node, removing all the packages it acknowledges. The round trip
+    time is sampled from the newest package acknowledged, if it was sent only once.
+    The credit of the stream is set from the ack.
+    @param ack The ack.
+    @param now The time the ack arrived.
+    @param uuids If not null, the uuids of the packages acknowledged are appended to it.
+    @return The number of packages acknowledged.
+    */
+   std::size_t AckTable::acknowledge(const SequenceAck & ack, std::chrono::steady_clock::time_point now, std::vector<boost::uuids::uuid> * uuids) {
+      auto stream = streams.find(ack.stream);
+      if (stream == streams.end()) {
+         return 0;
+      }
+      Stream & acknowledged = stream->second;
+      std::map<std::uint64_t, std::uint32_t> & pending = acknowledged.pending;
+      if (ack.credit >= 0) {
+         if (ack.credit > 0) {
+            acknowledged.probes = 0;
+         } else if (acknowledged.credit != 0) {
+            // Wait for the destination to tell it has space again, or probe it after the timeout.
+            acknowledged.nextProbe = now + roundTrips[acknowledged.target].timeout(1);
+         }
+      }
+      acknowledged.credit = ack.credit;
+      std::size_t count = 0;
+      // The newest package acknowledged, for the round trip sample.
+      std::chrono::steady_clock::time_point newestSent;
+      boost::asio::ip::udp::endpoint newestTarget;
+      bool newestSentOnce = false;
+      auto acknowledgeRange = [&](std::uint64_t first, std::uint64_t last) {
+         auto begin = pending.lower_bound(first);
+         while (begin != pending.end() && begin->first <= last) {
+            const std::uint32_t entryIndex = begin->second;
+            ++begin;
+            const Entry & entry = entries[entryIndex];
+            if (count == 0 || entry.sent > newestSent) {
+               newestSent = entry.sent;
+               newestTarget = entry.target;
+               newestSentOnce = (entry.attempts == 1);
+            }
+            if (uuids) {
+               uuids->push_back(entry.package.getUuid());
+            }
+            remove(entryIndex);
+            count++;
+         }
+      };
+      if (ack.cumulative > 0) {
+         acknowledgeRange(1, ack.cumulative);
+      }
+      for (const std::pair<std::uint64_t, std::uint64_t> & range : ack.ranges) {
+         acknowledgeRange(range.first, range.second);
+      }
+      // The ack of a resent package may be the ack of any of the sends, so it tells nothing of the round trip.
+      if (count > 0 && newestSentOnce) {
+         roundTrips[newestTarget].addSample(now - newestSent);
+      }
+      return count;
+   }
+
+   /**
+    Takes the packages whose deadline has passed. Packages which may still be resent stay in the
+    table, and the caller is expected to send them again and add them back with add(). Packages sent
+    the maximum number of times are removed from the table and given up.
+    @param now The current time.
+    @param resend The packages to resend are appended to this vector.
+    @param givenUp The packages given up are appended to this vector, with the destination set to
+    the address the package was sent to.
+    */
+   void AckTable::takeExpired(std::chrono::steady_clock::time_point now, std::vector<Package> & resend, std::vector<Package> & givenUp) {
+      expiredTimers.clear();
+      timers.advance(now, expiredTimers);
+      for (std::uint64_t id : expiredTimers) {
+         const std::uint32_t entryIndex = static_cast<std::uint32_t>(id);
+         Entry & entry = entries[entryIndex];
+         // The timer of a package already acknowledged, or of an earlier send of the package.
+         if (entry.generation != static_cast<std::uint32_t>(id >> 32) || entry.package.isEmpty()) {
+            continue;
+         }
+         if (entry.attempts > maxResends) {
+            Package package(entry.package);
+            remove(entryIndex);
+            package.setDestination(entry.target);
+            package.setSequence(0, 0);
+            givenUp.push_back(std::move(package));
+         } else {
+            // The entry stays until the package is resent, with no timer.
+            entry.generation++;
+            resend.push_back(entry.package);
+         }
+      }
+   }
+
+   /**
+    Gets the time when takeExpired() should be called next.
+    @return The time, or the maximum time point if no packages are waiting.
+    */
+   std::chrono::steady_clock::time_point AckTable::nextDeadline() const {
+      if (index.empty()) {
+         return std::chrono::steady_clock::time_point::max();
+      }
+      return timers.nextDeadline();
+   }
+
+   /**
+    Sets how many times a package not acknowledged is resent before it is given up.
+    @param resends The number of resends. Negative values are treated as zero.
+    */
+   void AckTable::setMaxResends(int resends) {
+      maxResends = std::max(0, resends);
+   }
+
+   /**
+    Gets how many times a package not acknowledged is resent before it is given up.
+    @return The number of resends.
+    */
+   int AckTable::getMaxResends() const {
+      return maxResends;
+   }
+
+   /**
+    Gets the round trip estimate of a destination.
+    @param target The destination.
+    @return The estimate.
+    */
+   const RetransmissionTimer & AckTable::roundTrip(const boost::asio::ip::udp::endpoint & target) {
+      return roundTrips[target];
+   }
+
+   /**
+    Gets the number of numbered packages sent to a destination and waiting for the ack.
+    @param target The destination.
+    @return The number of packages.
+    */
+   std::size_t AckTable::inFlight(const boost::asio::ip::udp::endpoint & target) const {
+      auto found = targetStreams.find(target);
+      if (found == targetStreams.end()) {
+         return 0;
+      }
+      auto stream = streams.find(found->second);
+      return stream != streams.end() ? stream->second.pending.size() : 0;
+   }
+
+   /**
+    Gets how many numbered packages may wait for the ack at a time at most, as the destination gave credit.
+    @param target The destination.
+    @return The credit, or the maximum value if the destination does not limit the packages.
+    */
+   std::size_t AckTable::credit(const boost::asio::ip::udp::endpoint & target) const {
+      auto found = targetStreams.find(target);
+      if (found != targetStreams.end()) {
+         auto stream = streams.find(found->second);
+         if (stream != streams.end() && stream->second.credit >= 0) {
+            return static_cast<std::size_t>(stream->second.credit);
+         }
+      }
+      return std::numeric_limits<std::size_t>::max();
+   }
+
+   /**
+    Use to query if a package may be sent to a destination which gave no credit, to probe if it has space
+    again, in case the ack telling it was lost. A probe may be sent when no packages are waiting for the ack
+    and the probe timeout has passed. The timeout starts from the resend timeout and is doubled for each probe.
+    @param target The destination.
+    @param now The current time.
+    @return Returns true if one package may be sent now.
+    */
+   bool AckTable::probe(const boost::asio::ip::udp::endpoint & target, std::chrono::steady_clock::time_point now) {
+      auto found = targetStreams.find(target);
+      if (found == targetStreams.end()) {
+         return false;
+      }
+      Stream & stream = streams[found->second];
+      if (stream.credit != 0 || !stream.pending.empty() || now < stream.nextProbe) {
+         return false;
+      }
+      stream.probes++;
+      stream.nextProbe = now + roundTrips[target].timeout(stream.probes + 1);
+      return true;
+   }
+
+   /**
+    Gets the time when the next probe may be sent to a destination which gave no credit.
+    @return The time, or the maximum time point if no destination is waiting for a probe.
+    */
+   std::chrono::steady_clock::time_point AckTable::nextProbe() const {
+      std::chrono::steady_clock::time_point next = std::chrono::steady_clock::time_point::max();
+      for (const auto & item : streams) {
+         const Stream & stream = item.second;
+         if (stream.credit == 0 && stream.pending.empty()) {
+            next = std::min(next, stream.nextProbe);
+         }
+      }
+      return next;
+   }
+
+   /**
+    Gets the number of packages waiting for the ack.
+    @return The number of packages.
+    */
+   std::size_t AckTable::size() const {
+      return index.size();
+   }
+
+   /**
+    Use to query if no packages are waiting for the ack.
+    @return Returns true if the table is empty.
+    */
+   bool AckTable::isEmpty() const {
+      return index.empty();
+   }
+
+   /**
+    Removes all the packages from the table.
+    */
+   void AckTable::clear() {
+      streams.clear();
+      targetStreams.clear();
+      index.clear();
+      entries.clear();
+      freeEntries.clear();
+      timers.clear();
+   }
+
+   /**
+    Removes a package from the indexes and releases its entry.
+    @param entryIndex The entry of the package.
+    */
+   void AckTable::remove(std::uint32_t entryIndex) {
+      const Package & package = entries[entryIndex].package;
+      index.erase(Key{package.getUuid(), package.hasDestination() ? package.destinationEndpoint() : boost::asio::ip::udp::endpoint()});
+      if (package.hasSequence()) {
+         auto stream = streams.find(package.getStream());
+         if (stream != streams.end()) {
+            stream->second.pending.erase(package.getSequence());
+         }
+      }
+      release(entryIndex);
+   }
+
+   /**
+    Puts an entry to the free list, invalidating the timer of the package in it.
+    @param entryIndex The entry to release.
+    */
+   void AckTable::release(std::uint32_t entryIndex) {
+      Entry & entry = entries[entryIndex];
+      entry.package = Package(boost::uuids::nil_uuid());
+      entry.generation++;
+      freeEntries.push_back(entryIndex);
+   }
+
+   bool AckTable::Key::operator ==(const Key & other) const {
+      return uuid == other.uuid && destination == other.destination;
+   }
+
+   std::size_t AckTable::KeyHash::operator ()(const Key & key) const {
+      std::size_t seed = boost::hash<boost::uuids::uuid>()(key.uuid);
+      boost::hash_combine(seed, key.destination.port());
+      if (key.destination.address().is_v4()) {
+         boost::hash_combine(seed, key.destination.address().to_v4().to_uint());
+      } else {
+         boost::hash_combine(seed, key.destination.address().to_string());
+      }
+      return seed;
+   }
+
+} //namespace
@@ -0,0 +1,178 @@
+//
+//  BinaryEnvelope.cpp
+//  ProcessorNode
+//
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <ProcessorNode/BinaryEnvelope.h>
+
+namespace OHARBase {
+
+   /** Flag telling the sender's listening port follows. */
+   static const std::uint8_t ORIGIN_FLAG{0x01};
+   /** Flag telling the stream and the sequence number follow. */
+   static const std::uint8_t SEQUENCE_FLAG{0x02};
+   /** Flag telling the payload is the JSON text of a JSON value payload. */
+   static const std::uint8_t JSON_FLAG{0x04};
+   /** Flag telling the base of the sequence follows the sequence number. */
+   static const std::uint8_t BASE_FLAG{0x08};
+   /** Size of the fixed part of the envelope: magic, version, uuid, type and flags. */
+   static const std::size_t FIXED_SIZE{20};
+   /** The longest varint, of a 64 bit value. */
+   static const std::size_t MAX_VARINT_SIZE{10};
+
+   /**
+    Checks if the received data is a package in the binary envelope.
+    @param data The received bytes.
+    @param length Number of received bytes.
+    @return Returns true if the data starts with the envelope magic byte.
+    */
+   bool BinaryEnvelope::isEnvelope(const char * data, std::size_t length) {
+      return length > 0 && static_cast<std::uint8_t>(data[0]) == Magic;
+   }
+
+   /**
+    Serializes a package into the binary envelope.
+    @param package The package to serialize.
+    @param data The serialized package replaces the contents of this string.
+    */
+   void BinaryEnvelope::encode(const Package & package, std::string & data) {
+      const nlohmann::json * value = package.getPayloadJson();
+      std::string text;
+      if (value) {
+         text = value->dump();
+      }
+      const std::string & payload = value ? text : package.getPayloadString();
+      std::uint8_t flags = 0;
+      if (package.originPort() != 0) {
+         flags |= ORIGIN_FLAG;
+      }
+      if (package.hasSequence()) {
+         flags |= SEQUENCE_FLAG;
+      }
+      if (value) {
+         flags |= JSON_FLAG;
+      }
+      if (package.hasSequence() && package.getSequenceBase() != 0) {
+         flags |= BASE_FLAG;
+      }
+      data.clear();
+      data.reserve(FIXED_SIZE + 5 * MAX_VARINT_SIZE + payload.length());
+      data.push_back(static_cast<char>(Magic));
+      data.push_back(static_cast<char>(Version));
+      data.append(reinterpret_cast<const char*>(package.getUuid().begin()), package.getUuid().size());
+      data.push_back(static_cast<char>(package.getType()));
+      data.push_back(static_cast<char>(flags));
+      if (flags & ORIGIN_FLAG) {
+         appendVarint(package.originPort(), data);
+      }
+      if (flags & SEQUENCE_FLAG) {
+         appendVarint(package.getStream(), data);
+         appendVarint(package.getSequence(), data);
+         if (flags & BASE_FLAG) {
+            appendVarint(package.getSequenceBase(), data);
+         }
+      }
+      appendVarint(payload.length(), data);
+      data.append(payload);
+   }
+
+   /**
+    Parses a package from the binary envelope. As with JSON, the origin is the sender's listening port
+    only, and the package has no destination.
+    @param data The serialized package.
+    @param length Length of the serialized package.
+    @param package The package to parse the data into.
+    @throws std::runtime_error if the data is not a valid envelope, nlohmann::json::parse_error if a JSON value payload is not valid JSON.
+    */
+   void BinaryEnvelope::decode(const char * data, std::size_t length, Package & package) {
+      if (length < FIXED_SIZE || !isEnvelope(data, length)) {
+         throw std::runtime_error("Binary envelope too short");
+      }
+      const unsigned char * position = reinterpret_cast<const unsigned char*>(data);
+      const unsigned char * end = position + length;
+      if (position[1] != Version) {
+         throw std::runtime_error("Unsupported binary envelope version " + std::to_string(position[1]));
+      }
+      boost::uuids::uuid uuid;
+      std::copy(position + 2, position + 18, uuid.begin());
+      const std::uint8_t type = position[18];
+      const std::uint8_t flags = position[19];
+      if (type > Package::Acknowledgement) {
+         throw std::runtime_error("Invalid package type " + std::to_string(type) + " in binary envelope");
+      }
+      position += FIXED_SIZE;
+      std::uint64_t originPort = 0;
+      if (flags & ORIGIN_FLAG) {
+         originPort = readVarint(position, end);
+         if (originPort > 0xFFFF) {
+            throw std::runtime_error("Invalid port in binary envelope");
+         }
+      }
+      std::uint64_t stream = 0;
+      std::uint64_t sequence = 0;
+      std::uint64_t base = 0;
+      if (flags & SEQUENCE_FLAG) {
+         stream = readVarint(position, end);
+         sequence = readVarint(position, end);
+         if (flags & BASE_FLAG) {
+            base = readVarint(position, end);
+         }
+         if (stream > 0xFFFFFFFF) {
+            throw std::runtime_error("Invalid stream in binary envelope");
+         }
+      }
+      const std::uint64_t payloadLength = readVarint(position, end);
+      if (payloadLength != static_cast<std::uint64_t>(end - position)) {
+         throw std::runtime_error("Payload length does not match the binary envelope");
+      }
+      package.setUuid(uuid);
+      package.setType(static_cast<Package::Type>(type));
+      if (flags & JSON_FLAG) {
+         package.setPayloadJson(nlohmann::json::parse(position, end), static_cast<std::size_t>(payloadLength));
+      } else {
+         package.setPayload(std::string(reinterpret_cast<const char*>(position), static_cast<std::size_t>(payloadLength)));
+      }
+      package.setOrigin(boost::asio::ip::udp::endpoint(boost::asio::ip::address_v4(), static_cast<unsigned short>(originPort)));
+      package.setSequence(static_cast<std::uint32_t>(stream), sequence);
+      package.setSequenceBase(base);
+   }
+
+   /**
+    Appends a varint to the data.
+    @param value The value.
+    @param data The string to append to.
+    */
+   void BinaryEnvelope::appendVarint(std::uint64_t value, std::string & data) {
+      while (value >= 0x80) {
+         data.push_back(static_cast<char>((value & 0x7F) | 0x80));
+         value >>= 7;
+      }
+      data.push_back(static_cast<char>(value));
+   }
+
+   /**
+    Reads a varint from the data.
+    @param position Where the varint starts, moved past the varint.
+    @param end The end of the data.
+    @return The value.
+    @throws std::runtime_error if the varint is cut short or too long.
+    */
+   std::uint64_t BinaryEnvelope::readVarint(const unsigned char * & position, const unsigned char * end) {
+      std::uint64_t value = 0;
+      for (unsigned shift = 0; shift < 7 * MAX_VARINT_SIZE; shift += 7) {
+         if (position == end) {
+            throw std::runtime_error("Binary envelope ends in the middle of a number");
+         }
+         const unsigned char byte = *position++;
+         value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+         if ((byte & 0x80) == 0) {
+            return value;
+         }
+      }
+      throw std::runtime_error("Too long number in binary envelope");
+   }
+
+} //namespace
@@ -44,6 +44,36 @@ const std::string ConfigurationDataItem::CONF_NODENAME{"name"};
 const std::string ConfigurationDataItem::CONF_ENCRYPT{"encrypt"};
 /** Configuration data item name for specifying if ack messages are sent to previous node about arriving data packages.*/
 const std::string ConfigurationDataItem::CONF_USE_ACK{"use-ack"};
+/** Configuration data item name for the maximum number of datagrams the input reader drains in one batch.*/
+const std::string ConfigurationDataItem::CONF_INPUT_BATCH{"input-batch"};
+/** Configuration data item name for the number of sockets (and threads) the input port is read with.*/
+const std::string ConfigurationDataItem::CONF_INPUT_SHARDS{"input-shards"};
+/** Configuration data item name for the maximum number of packages the output writer sends in one flush.*/
+const std::string ConfigurationDataItem::CONF_OUTPUT_BATCH{"output-batch"};
+/** Configuration data item name for the maximum size of a package sent and received in fragments.*/
+const std::string ConfigurationDataItem::CONF_MAX_PACKAGE_SIZE{"max-package-size"};
+/** Configuration data item name for the rules routing outgoing packages to destinations by their contents.*/
+const std::string ConfigurationDataItem::CONF_ROUTES{"routes"};
+/** Configuration data item name for how many times a package not acknowledged is resent before giving it up.*/
+const std::string ConfigurationDataItem::CONF_ACK_RETRIES{"ack-retries"};
+/** Configuration data item name for how many packages sent to a destination may wait for the ack at a time.*/
+const std::string ConfigurationDataItem::CONF_ACK_WINDOW{"ack-window"};
+/** Configuration data item name for how many packages the input queue and the send queue of the node hold at most.*/
+const std::string ConfigurationDataItem::CONF_QUEUE_LIMIT{"queue-limit"};
+/** Configuration data item name for the rate limits of the destinations packages are sent to.*/
+const std::string ConfigurationDataItem::CONF_OUTPUT_RATE{"output-rate"};
+/** Configuration data item name for how many bytes of packages the input queue and the send queue of the node hold at most.*/
+const std::string ConfigurationDataItem::CONF_QUEUE_BYTES{"queue-bytes"};
+/** Configuration data item name for what is done when a package arrives to a full queue.*/
+const std::string ConfigurationDataItem::CONF_QUEUE_OVERFLOW{"queue-overflow"};
+/** Configuration data item name for the directory where the data packages sent are kept until delivered.*/
+const std::string ConfigurationDataItem::CONF_OUTPUT_LOG{"output-log"};
+/** Configuration data item name for the format the packages are sent in.*/
+const std::string ConfigurationDataItem::CONF_OUTPUT_FORMAT{"output-format"};
+/** Configuration data item name for passing the payloads of data packages through without parsing them.*/
+const std::string ConfigurationDataItem::CONF_CUT_THROUGH{"cut-through"};
+/** Configuration data item name for the version of the uuids generated for packages.*/
+const std::string ConfigurationDataItem::CONF_UUID_VERSION{"uuid-version"};
 
 /**
  Sets the configuration data item name.
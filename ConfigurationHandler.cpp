@@ -70,9 +70,9 @@ bool ConfigurationHandler::consume(Package & data) {
          LOG(INFO) << "Step 2 " << configuration.dump();
          Package package;
          package.setType(Package::Configuration);
-         package.setPayload(configuration.dump());
-         package.setDestination(data.origin());
-         node.sendData(package);
+         package.setPayloadJson(std::move(configuration));
+         package.setDestination(data.originEndpoint());
+         node.sendData(std::move(package));
          /*
           "payload" :
           {
@@ -84,7 +84,7 @@ bool ConfigurationHandler::consume(Package & data) {
           ]
           }
           */
-      } else if (payload == ConfigSetOperation) {
+      } else if (data.getPayloadJson() || payload == ConfigSetOperation) {
          // Parse payload to see if operation is set.
          // Info is only received by the remote configurator app.
          // When operation is set, parse config save it to file and tell Node to read & set new config.
@@ -99,9 +99,15 @@ bool ConfigurationHandler::consume(Package & data) {
              ]
           }
           */
-         nlohmann::json jsonData = nlohmann::json::parse(data.getPayloadString());
-         if (jsonData.find("operation") != jsonData.end()) {
-            std::string operation = jsonData["operation"].get<std::string>();
+         // The payload is embedded in the package as a JSON object, or in older senders, a string.
+         nlohmann::json parsed;
+         const nlohmann::json * jsonData = data.getPayloadJson();
+         if (!jsonData) {
+            parsed = nlohmann::json::parse(data.getPayloadString());
+            jsonData = &parsed;
+         }
+         if (jsonData->is_object() && jsonData->find("operation") != jsonData->end()) {
+            std::string operation = (*jsonData)["operation"].get<std::string>();
             if (operation == ConfigSetOperation) {
                
             }
@@ -36,7 +36,9 @@ EncryptHandler::~EncryptHandler() {
  */
 bool EncryptHandler::consume(OHARBase::Package & package) {
    if (package.getType() == OHARBase::Package::Data) {
-      const std::string jsonString = package.getPayloadString();
+      // A JSON value payload is encrypted as its JSON text.
+      const nlohmann::json * value = package.getPayloadJson();
+      const std::string jsonString = value ? value->dump() : package.getPayloadString();
       if (jsonString.length() > 0) {
          std::string result;
          // With rot13, both encrypt and decrypt do the same thing, just want to show here that there are two ops to do,
@@ -0,0 +1,167 @@
+//
+//  FragmentAssembler.cpp
+//  ProcessorNode
+//
+
+#include <algorithm>
+
+#include <g3log/g3log.hpp>
+
+#include <ProcessorNode/FragmentAssembler.h>
+
+namespace OHARBase {
+
+   const std::string FragmentAssembler::TAG{"Assembler "};
+   /** How long the fragments of a package are waited for before the package is dropped. */
+   static const std::chrono::seconds REASSEMBLY_TIMEOUT{5};
+   /** How many packages can be under reassembly at the same time. */
+   static const std::size_t MAX_PACKAGES_UNDER_REASSEMBLY{64};
+   /** Default maximum size of a reassembled package. */
+   static const std::size_t DEFAULT_MAX_PACKAGE_SIZE{65536};
+
+   /**
+    Constructs the assembler with the default maximum package size of 64 KB.
+    @param maxDatagramSize Maximum size of a datagram the fragments were split to fit, including the fragment header.
+    */
+   FragmentAssembler::FragmentAssembler(std::size_t maxDatagramSize)
+   : bufferedBytes(0), maxPackageSize(DEFAULT_MAX_PACKAGE_SIZE), chunkSize(maxDatagramSize - Fragmenter::HeaderSize)
+   {
+   }
+
+   /**
+    Sets the maximum size of a package that is reassembled. Fragments of larger packages are dropped.
+    The bytes buffered for all packages under reassembly are limited to a multiple of this size.
+    @param size The maximum package size in bytes.
+    */
+   void FragmentAssembler::setMaxPackageSize(std::size_t size) {
+      maxPackageSize = size;
+   }
+
+   /**
+    Gets the maximum size of a package that is reassembled.
+    @return The maximum package size in bytes.
+    */
+   std::size_t FragmentAssembler::getMaxPackageSize() const {
+      return maxPackageSize;
+   }
+
+   /**
+    Gets the number of packages waiting for more fragments.
+    @return Number of packages under reassembly.
+    */
+   std::size_t FragmentAssembler::packagesUnderReassembly() const {
+      return assemblies.size();
+   }
+
+   /**
+    Adds a received fragment. When the last missing fragment of a package arrives,
+    the whole serialized package is given to the caller.
+    @param data The received fragment, including the fragment header.
+    @param length Length of the fragment.
+    @param from The sender of the fragment.
+    @param package Filled with the reassembled package when all fragments have been received.
+    @return Returns true if the package was completed by this fragment.
+    */
+   bool FragmentAssembler::add(const char * data, std::size_t length, const boost::asio::ip::udp::endpoint & from, std::string & package) {
+      Fragmenter::Header header;
+      if (!Fragmenter::parseHeader(data, length, header)) {
+         LOG(WARNING) << TAG << "Invalid fragment header from " << from.address() << ":" << from.port();
+         return false;
+      }
+      if (header.totalLength > maxPackageSize) {
+         LOG(WARNING) << TAG << "Dropped fragment of a package of " << header.totalLength << " bytes, maximum is " << maxPackageSize;
+         return false;
+      }
+      if (header.count != (header.totalLength + chunkSize - 1) / chunkSize) {
+         LOG(WARNING) << TAG << "Dropped fragment of a package of " << header.totalLength << " bytes in " << header.count << " fragments";
+         return false;
+      }
+      const auto now = std::chrono::steady_clock::now();
+      evictExpired(now);
+
+      AssemblyKey key{from, header.uuid};
+      auto iter = assemblies.find(key);
+      if (iter == assemblies.end()) {
+         while (assemblies.size() >= MAX_PACKAGES_UNDER_REASSEMBLY) {
+            evictOldest();
+         }
+         Assembly assembly;
+         assembly.fragments.resize(header.count);
+         assembly.received = 0;
+         assembly.bytes = 0;
+         assembly.totalLength = header.totalLength;
+         assembly.started = now;
+         iter = assemblies.emplace(key, std::move(assembly)).first;
+      }
+      Assembly & assembly = iter->second;
+      const std::size_t size = length - Fragmenter::HeaderSize;
+      if (assembly.fragments.size() != header.count || assembly.totalLength != header.totalLength) {
+         LOG(WARNING) << TAG << "Fragment does not match the package under reassembly, dropping the package";
+         bufferedBytes -= assembly.bytes;
+         assemblies.erase(iter);
+         return false;
+      }
+      std::string & fragment = assembly.fragments[header.index];
+      // Duplicate fragments of a resent package are not counted against the total length.
+      if (fragment.empty() && assembly.bytes + size > assembly.totalLength) {
+         LOG(WARNING) << TAG << "Fragment does not match the package under reassembly, dropping the package";
+         bufferedBytes -= assembly.bytes;
+         assemblies.erase(iter);
+         return false;
+      }
+      if (fragment.empty() && size > 0) {
+         // Duplicate fragments (from resent packages) are ignored.
+         fragment.assign(data + Fragmenter::HeaderSize, size);
+         assembly.received++;
+         assembly.bytes += size;
+         bufferedBytes += size;
+      }
+      if (assembly.received == assembly.fragments.size()) {
+         package.clear();
+         package.reserve(assembly.totalLength);
+         for (const std::string & part : assembly.fragments) {
+            package.append(part);
+         }
+         bufferedBytes -= assembly.bytes;
+         assemblies.erase(iter);
+         LOG(INFO) << TAG << "Reassembled a package of " << package.length() << " bytes";
+         return package.length() == header.totalLength;
+      }
+      // Keep the memory used by the reassembly buffers bounded.
+      while (bufferedBytes > MAX_PACKAGES_UNDER_REASSEMBLY * maxPackageSize / 4 && assemblies.size() > 1) {
+         evictOldest();
+      }
+      return false;
+   }
+
+   /**
+    Drops the packages which have been under reassembly longer than the timeout.
+    @param now The current time.
+    */
+   void FragmentAssembler::evictExpired(const std::chrono::steady_clock::time_point & now) {
+      for (auto iter = assemblies.begin(); iter != assemblies.end(); ) {
+         if (now - iter->second.started > REASSEMBLY_TIMEOUT) {
+            LOG(WARNING) << TAG << "Fragments of a package did not arrive in time, dropping " << iter->second.received << "/" << iter->second.fragments.size() << " fragments";
+            bufferedBytes -= iter->second.bytes;
+            iter = assemblies.erase(iter);
+         } else {
+            ++iter;
+         }
+      }
+   }
+
+   /**
+    Drops the package which has been under reassembly for the longest time.
+    */
+   void FragmentAssembler::evictOldest() {
+      auto oldest = std::min_element(assemblies.begin(), assemblies.end(), [](const auto & a, const auto & b) {
+         return a.second.started < b.second.started;
+      });
+      if (oldest != assemblies.end()) {
+         LOG(WARNING) << TAG << "Too many packages under reassembly, dropping the oldest";
+         bufferedBytes -= oldest->second.bytes;
+         assemblies.erase(oldest);
+      }
+   }
+
+} //namespace
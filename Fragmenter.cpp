@@ -0,0 +1,82 @@
+//
+//  Fragmenter.cpp
+//  ProcessorNode
+//
+
+#include <algorithm>
+
+#include <ProcessorNode/Fragmenter.h>
+
+namespace OHARBase {
+
+   /**
+    Checks if the received datagram is a fragment of a package.
+    @param data The received bytes.
+    @param length Number of received bytes.
+    @return Returns true if the datagram starts with the fragment header.
+    */
+   bool Fragmenter::isFragment(const char * data, std::size_t length) {
+      return length >= HeaderSize && static_cast<std::uint8_t>(data[0]) == Magic;
+   }
+
+   /**
+    Parses the fragment header from a received datagram.
+    @param data The received bytes.
+    @param length Number of received bytes.
+    @param header The header to fill from the data.
+    @return Returns true if the header was valid.
+    */
+   bool Fragmenter::parseHeader(const char * data, std::size_t length, Header & header) {
+      if (!isFragment(data, length) || static_cast<std::uint8_t>(data[1]) != Version) {
+         return false;
+      }
+      const unsigned char * bytes = reinterpret_cast<const unsigned char*>(data);
+      std::copy(bytes + 2, bytes + 18, header.uuid.begin());
+      header.index = static_cast<std::uint16_t>((bytes[18] << 8) | bytes[19]);
+      header.count = static_cast<std::uint16_t>((bytes[20] << 8) | bytes[21]);
+      header.totalLength = (static_cast<std::uint32_t>(bytes[22]) << 24) | (static_cast<std::uint32_t>(bytes[23]) << 16) |
+                           (static_cast<std::uint32_t>(bytes[24]) << 8) | static_cast<std::uint32_t>(bytes[25]);
+      return header.count > 0 && header.index < header.count;
+   }
+
+   /**
+    Splits the serialized package into fragments fitting into datagrams of the given size.
+    @param id The uuid of the package, used to put the fragments together in the receiver.
+    @param data The serialized package.
+    @param maxDatagramSize Maximum size of a datagram, including the fragment header.
+    @param fragments The container where the fragments are appended to.
+    @return The number of fragments appended, zero if the package cannot be fragmented.
+    */
+   std::size_t Fragmenter::split(const boost::uuids::uuid & id, const std::string & data, std::size_t maxDatagramSize, std::vector<std::string> & fragments) {
+      if (maxDatagramSize <= HeaderSize) {
+         return 0;
+      }
+      const std::size_t chunkSize = maxDatagramSize - HeaderSize;
+      const std::size_t count = (data.length() + chunkSize - 1) / chunkSize;
+      if (count == 0 || count > 0xFFFF || data.length() > 0xFFFFFFFF) {
+         return 0;
+      }
+      const std::uint32_t total = static_cast<std::uint32_t>(data.length());
+      for (std::size_t index = 0; index < count; index++) {
+         const std::size_t offset = index * chunkSize;
+         const std::size_t size = std::min(chunkSize, data.length() - offset);
+         std::string fragment;
+         fragment.reserve(HeaderSize + size);
+         fragment.push_back(static_cast<char>(Magic));
+         fragment.push_back(static_cast<char>(Version));
+         fragment.append(reinterpret_cast<const char*>(id.begin()), id.size());
+         fragment.push_back(static_cast<char>((index >> 8) & 0xFF));
+         fragment.push_back(static_cast<char>(index & 0xFF));
+         fragment.push_back(static_cast<char>((count >> 8) & 0xFF));
+         fragment.push_back(static_cast<char>(count & 0xFF));
+         fragment.push_back(static_cast<char>((total >> 24) & 0xFF));
+         fragment.push_back(static_cast<char>((total >> 16) & 0xFF));
+         fragment.push_back(static_cast<char>((total >> 8) & 0xFF));
+         fragment.push_back(static_cast<char>(total & 0xFF));
+         fragment.append(data, offset, size);
+         fragments.push_back(std::move(fragment));
+      }
+      return count;
+   }
+
+} //namespace
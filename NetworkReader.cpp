@@ -6,8 +6,16 @@
 //  Copyright (c) 2013 Antti Juustila. All rights reserved.
 //
 
+#if defined(__linux__)
+#include <sys/socket.h>
+#endif
+
+#include <algorithm>
+#include <limits>
+
 #include <boost/bind.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/uuid/uuid_io.hpp>
 
 #include <g3log/g3log.hpp>
 
@@ -15,11 +23,21 @@
 
 #include <ProcessorNode/NetworkReader.h>
 #include <ProcessorNode/NetworkReaderObserver.h>
+#include <ProcessorNode/BinaryEnvelope.h>
+#include <ProcessorNode/PackageScanner.h>
 
 
 namespace OHARBase {
    
    const std::string NetworkReader::TAG{"NetReader "};
+#if defined(SO_REUSEPORT)
+   /** Socket option for opening the same port with several sockets, the kernel balancing the datagrams between them. */
+   using reuse_port = boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+   /** How long acks are delayed to coalesce the acks of the packages arriving meanwhile. */
+   static const std::chrono::milliseconds ACK_DELAY{10};
+   /** Default number of packages the queue holds at most before the senders are given no credit. */
+   static const std::size_t DEFAULT_QUEUE_LIMIT{10000};
    
    /**
     Constructor to create the reader with a port to listen to.
@@ -31,7 +49,7 @@ namespace OHARBase {
    NetworkReader::NetworkReader(int port,
                               NetworkReaderObserver & obs,
                               boost::asio::io_service & io_s, bool reuseAddress)
-   :		Networker("", port, io_s), observer(obs), doReuseAddress(reuseAddress)
+   :		Networker("", port, io_s), observer(obs), ioService(io_s), doReuseAddress(reuseAddress), sendAckMessages(false), ackTimer(io_s), ackTimerRunning(false), queueLimit(DEFAULT_QUEUE_LIMIT), queueBytes(0), batchSize(1), assembler(BufferSize), transport(Transport::Datagram), ringThread(nullptr), shardCount(1), doReusePort(false), nextShard(0), cutThrough(false)
    {
    }
    
@@ -47,6 +65,36 @@ namespace OHARBase {
       running = true;
       sendAckMessages = useAcknowledgements;
       
+      if (transport == Transport::Stream) {
+         // TCP delivers the packages reliably, so no acks are sent for them.
+         sendAckMessages = false;
+         streamListener.reset(new StreamListener(ioService, [this](std::vector<std::string> & frames, const boost::asio::ip::tcp::endpoint & from) {
+            handleFrames(frames, from);
+         }));
+         streamListener->setMaxFrameSize(assembler.getMaxPackageSize());
+         streamListener->start(port);
+         return;
+      }
+      if (transport == Transport::SharedMemory) {
+         // The ring delivers the packages reliably, so no acks are sent for them.
+         sendAckMessages = false;
+         ring.reset(new SharedMemoryRing(ringName, SharedMemoryRing::Consumer));
+         ringThread = new std::thread(&NetworkReader::readRing, this);
+         return;
+      }
+      const PackageQueue::Overflow overflow = msgQueue.getOverflow();
+      if (sendAckMessages && (overflow == PackageQueue::Overflow::DropOldest || overflow == PackageQueue::Overflow::DropByType)) {
+         // The data packages in the queue have been acknowledged, so dropping them to make room would lose them.
+         // Arriving data packages are dropped instead, not acknowledged, and resent by the senders.
+         LOG(INFO) << TAG << "Packages in the queue are acknowledged, dropping the newest data packages when the queue is full.";
+         msgQueue.setOverflow(PackageQueue::Overflow::Block);
+      }
+#if defined(SO_REUSEPORT)
+      if (shardCount > 1) {
+         startShards(useAcknowledgements);
+         return;
+      }
+#endif
       buffer->fill(0);
 
       using namespace boost::asio::ip;
@@ -57,10 +105,204 @@ namespace OHARBase {
       if (doReuseAddress) {
          socket.set_option(boost::asio::ip::udp::socket::reuse_address(true));
       }
+#if defined(SO_REUSEPORT)
+      if (doReusePort) {
+         socket.set_option(reuse_port(true));
+      }
+#endif
       boost::system::error_code ec;
       socket.bind(remote_endpoint, ec);
       LOG(INFO) << TAG << "Bind code: " << ec;
-      readSocket();
+      if (batchSize > 1) {
+         receiveRing.resize(batchSize);
+         ringEndpoints.resize(batchSize);
+         ringLengths.resize(batchSize);
+         socket.non_blocking(true);
+         waitForDatagrams();
+      } else {
+         readSocket();
+      }
+   }
+
+   /**
+    Opens the input port with one socket per shard, each served by a thread and an io service of
+    its own and putting the received packages into a queue of its own. Shards are NetworkReaders
+    themselves, sharing the observer of this reader.
+    @param useAcknowledgements If true, ack messages are sent for the received data packages.
+    */
+   void NetworkReader::startShards(bool useAcknowledgements) {
+      LOG(INFO) << TAG << "Reading port " << port << " with " << shardCount << " sockets.";
+      running = true;
+      sendAckMessages = useAcknowledgements;
+      for (int index = 0; index < shardCount; index++) {
+         shardServices.emplace_back(new boost::asio::io_service());
+         NetworkReader * shard = new NetworkReader(port, observer, *shardServices.back());
+         shards.emplace_back(shard);
+         shard->doReusePort = true;
+         shard->setBatchSize(batchSize);
+         shard->setMaxPackageSize(assembler.getMaxPackageSize());
+         shard->setQueueLimit(queueLimit / static_cast<std::size_t>(shardCount));
+         shard->setQueueBytes(queueBytes / static_cast<std::size_t>(shardCount));
+         shard->setOverflow(msgQueue.getOverflow());
+         shard->setCutThrough(cutThrough);
+         shard->start(useAcknowledgements);
+      }
+      for (std::unique_ptr<boost::asio::io_service> & service : shardServices) {
+         boost::asio::io_service * s = service.get();
+         shardThreads.emplace_back([s] {
+            s->run();
+         });
+      }
+   }
+
+   /**
+    Stops the shards and waits for their threads to exit.
+    */
+   void NetworkReader::stopShards() {
+      for (std::unique_ptr<NetworkReader> & shard : shards) {
+         shard->stop();
+      }
+      for (std::thread & thread : shardThreads) {
+         if (thread.joinable()) {
+            thread.join();
+         }
+      }
+      shardThreads.clear();
+      shards.clear();
+      shardServices.clear();
+   }
+
+   /**
+    Sets how many sockets the input port is opened with. With more than one shard, each socket is served
+    by a thread of its own and the kernel balances the incoming datagrams between the sockets (using
+    SO_REUSEPORT), so that receiving is not limited by one thread. Datagrams from one sender go to the
+    same shard, so packages from one sender stay in order. Used with the datagram transport only.
+    Must be called before start().
+    @param count The number of sockets. Values smaller than 1 are treated as 1.
+    */
+   void NetworkReader::setShardCount(int count) {
+      shardCount = std::max(1, count);
+#if !defined(SO_REUSEPORT)
+      if (shardCount > 1) {
+         LOG(WARNING) << TAG << "SO_REUSEPORT not supported, reading the port with one socket.";
+         shardCount = 1;
+      }
+#endif
+   }
+
+   /**
+    Gets the number of sockets the input port is opened with.
+    @return The number of shards.
+    */
+   int NetworkReader::getShardCount() const {
+      return shardCount;
+   }
+
+   /**
+    Sets the cut-through mode. In the cut-through mode, the fields of data packages in JSON are read without
+    parsing the payload, and the payload is parsed only if a handler asks for it. Payloads no handler asks for
+    are sent on by the NetworkWriter as they were received, so a node passing packages through does not parse
+    and serialize them again. Must be called before start().
+    @param enabled True to read the data packages in the cut-through mode.
+    */
+   void NetworkReader::setCutThrough(bool enabled) {
+      cutThrough = enabled;
+   }
+
+   /**
+    Tells if data packages are read in the cut-through mode.
+    @return True if in the cut-through mode.
+    */
+   bool NetworkReader::isCutThrough() const {
+      return cutThrough;
+   }
+
+   /**
+    Sets how many datagrams the reader drains from the socket when the socket becomes readable.
+    With batch size larger than one, received packages are put into the queue under one lock and
+    the observer is notified once per batch. Must be called before start().
+    @param size The maximum number of datagrams in a batch. Values smaller than 1 are treated as 1.
+    */
+   void NetworkReader::setBatchSize(int size) {
+      batchSize = std::max(1, size);
+   }
+
+   /**
+    Gets the maximum number of datagrams received in one batch.
+    @return The batch size.
+    */
+   int NetworkReader::getBatchSize() const {
+      return batchSize;
+   }
+
+   /**
+    Sets the maximum size of packages received in fragments. Fragments of larger packages are dropped.
+    @param size The maximum package size in bytes.
+    */
+   void NetworkReader::setMaxPackageSize(std::size_t size) {
+      assembler.setMaxPackageSize(size);
+   }
+
+   /**
+    Sets how many packages the queue holds at most. When acks are used, the free space in the
+    queue is given to the senders as credit in the acks, and senders stop sending when they have no
+    credit. When the queue is full, the overflow policy applies. Must be called before start().
+    @param packages The maximum number of packages in the queue, 0 for no limit.
+    */
+   void NetworkReader::setQueueLimit(std::size_t packages) {
+      queueLimit = packages;
+      msgQueue.setPackageLimit(packages);
+   }
+
+   /**
+    Sets how many bytes of packages the queue holds at most. When the queue is full, the overflow
+    policy applies. Must be called before start().
+    @param bytes The maximum size of the packages in the queue, 0 for no limit.
+    */
+   void NetworkReader::setQueueBytes(std::size_t bytes) {
+      queueBytes = bytes;
+      msgQueue.setByteLimit(bytes);
+   }
+
+   /**
+    Sets what is done when a package arrives to a full queue. The reader cannot make the sender wait,
+    so with PackageQueue::Overflow::Block data packages are dropped like with the drop-newest policy.
+    Packages dropped on arrival are not acknowledged, so senders using acks resend them. The packages in the
+    queue have already been acknowledged, so with acks the policies dropping them to make room are used as
+    PackageQueue::Overflow::Block: arriving data packages are dropped, and other packages are queued over the limit.
+    Must be called before start().
+    @param policy The overflow policy.
+    */
+   void NetworkReader::setOverflow(PackageQueue::Overflow policy) {
+      msgQueue.setOverflow(policy);
+   }
+
+   /**
+    Sets the transport the reader receives packages with. With Transport::Stream, the reader
+    accepts TCP connections to the port and reads length-prefixed packages from them.
+    Must be called before start().
+    @param t The transport to use.
+    */
+   void NetworkReader::setTransport(Transport t) {
+      transport = t;
+   }
+
+   /**
+    Gets the transport the reader receives packages with.
+    @return The transport.
+    */
+   Networker::Transport NetworkReader::getTransport() const {
+      return transport;
+   }
+
+   /**
+    Makes the reader receive packages from a shared memory ring, written by a node on the same host.
+    The reader creates the ring when started. Must be called before start().
+    @param name The name of the ring, from the shm:// address.
+    */
+   void NetworkReader::setSharedMemoryRing(const std::string & name) {
+      transport = Transport::SharedMemory;
+      ringName = name;
    }
 
    /**
@@ -85,41 +327,11 @@ namespace OHARBase {
       if (!error || error == boost::asio::error::message_size)
       {
          if (buffer->data()) {
-            std::string buf;
-            buf.resize(bytes_transferred);
-            buf.assign(buffer->begin(), bytes_transferred);
-            LOG(INFO) << TAG << "Received " << bytes_transferred << " bytes: " << buf << " from " << remote_endpoint.address() << ":" << remote_endpoint.port();
-            if (buf.length()>0) {
-               try {
-                  nlohmann::json j = nlohmann::json::parse(buf);
-                  Package p = j.get<OHARBase::Package>();
-                  std::stringstream stream;
-                  stream << remote_endpoint.address() << ":";
-                  std::string port = p.getPackageOriginsListeningPort();
-                  if (port.length() > 0) {
-                     stream << port;
-                  } else {
-                     stream << remote_endpoint.port();
-                  }
-                  p.setOrigin(stream.str());
-                  LOG(INFO) << "Received package from origin " << p.origin();
-                  guard.lock();
-                  msgQueue.push(p);
-                  if (sendAckMessages && p.getType() == Package::Data) {
-                     Package ackMessage;
-                     ackMessage.setType(Package::Type::Acknowledgement);
-                     ackMessage.setPayload("ack");
-                     ackMessage.setDestination(p.origin());
-                     ackMessage.setUuid(p.getUuid());
-                     LOG(INFO) << "ackhandling: prepared an ack message to " << ackMessage.destination();
-                     msgQueue.push(ackMessage);
-                  }
-                  guard.unlock();
-                  // And when data has been received, notify the observer.
-                  observer.receivedData();
-               } catch (const std::exception & e) {
-                  observer.errorInData(e.what());
-               }
+            std::vector<Package> packages;
+            Package p(boost::uuids::nil_uuid());
+            if (parseDatagram(buffer->data(), bytes_transferred, remote_endpoint, p)) {
+               packages.push_back(std::move(p));
+               enqueue(packages);
             }
          } else {
             LOG(WARNING) << TAG << "Async recv finished but NO data";
@@ -132,31 +344,452 @@ namespace OHARBase {
       }
    }
    
+   /**
+    In batched mode, waits asynchronously until the socket has datagrams to read.
+    */
+   void NetworkReader::waitForDatagrams() {
+      socket.async_wait(boost::asio::ip::udp::socket::wait_read,
+                        boost::bind(&NetworkReader::handleReadable, this,
+                                    boost::asio::placeholders::error));
+   }
+   
+   /**
+    Called when the socket is readable in batched mode. Drains up to batchSize datagrams
+    into the receive ring, parses them and enqueues the packages with one lock acquisition,
+    notifying the observer once for the whole batch.
+    @param error Error code of the wait.
+    */
+   void NetworkReader::handleReadable(const boost::system::error_code & error) {
+      if (error) {
+         LOG_IF(WARNING, error != boost::asio::error::operation_aborted) << TAG << "Wait for datagrams failed " << error.value();
+         return;
+      }
+      std::size_t received = receiveBatch();
+      LOG(INFO) << TAG << "Received a batch of " << received << " datagrams";
+      if (received > 0) {
+         std::vector<Package> packages;
+         packages.reserve(received);
+         for (std::size_t index = 0; index < received; index++) {
+            Package p(boost::uuids::nil_uuid());
+            if (parseDatagram(receiveRing[index].data(), ringLengths[index], ringEndpoints[index], p)) {
+               packages.push_back(std::move(p));
+            }
+         }
+         enqueue(packages);
+      }
+      if (running) {
+         waitForDatagrams();
+      }
+   }
+   
+   /**
+    Reads the datagrams available in the non-blocking socket into the receive ring.
+    In Linux, all datagrams of a batch are received with a single recvmmsg call.
+    @return The number of datagrams received into the ring.
+    */
+   std::size_t NetworkReader::receiveBatch() {
+      std::size_t received = 0;
+#if defined(__linux__)
+      std::vector<mmsghdr> messages(batchSize);
+      std::vector<iovec> vectors(batchSize);
+      for (int index = 0; index < batchSize; index++) {
+         vectors[index].iov_base = receiveRing[index].data();
+         vectors[index].iov_len = BufferSize;
+         messages[index] = mmsghdr{};
+         messages[index].msg_hdr.msg_iov = &vectors[index];
+         messages[index].msg_hdr.msg_iovlen = 1;
+         messages[index].msg_hdr.msg_name = ringEndpoints[index].data();
+         messages[index].msg_hdr.msg_namelen = static_cast<socklen_t>(ringEndpoints[index].capacity());
+      }
+      int count = ::recvmmsg(socket.native_handle(), messages.data(), batchSize, MSG_DONTWAIT, nullptr);
+      if (count > 0) {
+         received = static_cast<std::size_t>(count);
+         for (std::size_t index = 0; index < received; index++) {
+            ringEndpoints[index].resize(messages[index].msg_hdr.msg_namelen);
+            // Truncated datagrams are handled like in the unbatched mode, with the bytes that fit the buffer.
+            ringLengths[index] = std::min<std::size_t>(messages[index].msg_len, BufferSize);
+         }
+      }
+#else
+      boost::system::error_code ec;
+      while (received < static_cast<std::size_t>(batchSize)) {
+         ringLengths[received] = socket.receive_from(boost::asio::buffer(receiveRing[received]), ringEndpoints[received], 0, ec);
+         if (ec && ec != boost::asio::error::message_size) {
+            break;
+         }
+         received++;
+      }
+#endif
+      return received;
+   }
+   
+   /**
+    Parses a datagram received from the network to a Package and sets the package origin address.
+    If the datagram is a fragment of a larger package, it is given to the assembler and the package
+    is parsed when the last of its fragments arrives.
+    @param data The received bytes.
+    @param length Number of bytes received.
+    @param from The address the datagram came from.
+    @param package The package to parse the data into.
+    @return Returns true if the datagram contained a package.
+    */
+   bool NetworkReader::parseDatagram(const char * data, std::size_t length, const boost::asio::ip::udp::endpoint & from, Package & package) {
+      if (length == 0) {
+         return false;
+      }
+      std::string buf;
+      if (Fragmenter::isFragment(data, length)) {
+         if (!assembler.add(data, length, from, buf)) {
+            return false;
+         }
+      } else {
+         buf.assign(data, length);
+      }
+      return parsePackage(buf.data(), buf.length(), from.address(), from.port(), package);
+   }
+   
+   /**
+    Parses a serialized package and sets the package origin address. The package may be
+    in JSON or in the binary envelope, told apart by the first byte. In the cut-through mode,
+    the payload of a data package in JSON is not parsed.
+    @param data The serialized package.
+    @param length Length of the serialized package.
+    @param from The address the package came from.
+    @param fromPort The port the package came from, used as the origin port if the package does not tell the sender's listening port.
+    @param package The package to parse the data into.
+    @return Returns true if the data contained a package.
+    */
+   bool NetworkReader::parsePackage(const char * data, std::size_t length, const boost::asio::ip::address & from, unsigned short fromPort, Package & package) {
+      LOG(INFO) << TAG << "Received " << length << " bytes from " << from << ":" << fromPort;
+      try {
+         if (BinaryEnvelope::isEnvelope(data, length)) {
+            BinaryEnvelope::decode(data, length, package);
+         } else if (!(cutThrough && PackageScanner::scan(data, length, package))) {
+            nlohmann::json j = nlohmann::json::parse(data, data + length);
+            // An embedded JSON payload is moved to the package instead of copying it. The length of the
+            // package is counted as its size in the queues, as the payload length is not known.
+            auto payload = j.find("payload");
+            if (payload != j.end() && !payload->is_string()) {
+               nlohmann::json value = std::move(*payload);
+               j.erase(payload);
+               package = j.get<OHARBase::Package>();
+               package.setPayloadJson(std::move(value), length);
+            } else {
+               package = j.get<OHARBase::Package>();
+            }
+         }
+         // The origin is the sender's address and its listening port, if the package tells it.
+         const unsigned short listeningPort = package.originPort();
+         package.setOrigin(boost::asio::ip::udp::endpoint(from, listeningPort != 0 ? listeningPort : fromPort));
+         LOG(INFO) << "Received package from origin " << package.originEndpoint();
+         return true;
+      } catch (const std::exception & e) {
+         observer.errorInData(e.what());
+      }
+      return false;
+   }
+   
+   /**
+    Handles the frames read from a TCP connection in one read, and enqueues the packages together.
+    @param frames The serialized packages.
+    @param from The sender of the packages.
+    */
+   void NetworkReader::handleFrames(std::vector<std::string> & frames, const boost::asio::ip::tcp::endpoint & from) {
+      std::vector<Package> packages;
+      packages.reserve(frames.size());
+      for (const std::string & frame : frames) {
+         Package p(boost::uuids::nil_uuid());
+         if (parsePackage(frame.data(), frame.length(), from.address(), from.port(), p)) {
+            packages.push_back(std::move(p));
+         }
+      }
+      enqueue(packages);
+   }
+   
+   /**
+    Thread function reading the shared memory ring. Waits for the sending node to write packages
+    into the ring, parses all the packages available directly from the shared memory and enqueues
+    them together. The space is released to the sender only after the packages are parsed.
+    */
+   void NetworkReader::readRing() {
+      LOG(INFO) << TAG << "Reading packages from shared memory ring " << ringName;
+      const boost::asio::ip::address local = boost::asio::ip::address_v4::loopback();
+      std::vector<SharedMemoryRing::Record> records;
+      std::vector<Package> packages;
+      while (running) {
+         // Wake up now and then to notice if the reader was stopped.
+         if (!ring->waitForRecords(std::chrono::milliseconds(100))) {
+            continue;
+         }
+         records.clear();
+         ring->peek(records);
+         for (const SharedMemoryRing::Record & record : records) {
+            Package p(boost::uuids::nil_uuid());
+            if (parsePackage(record.data, record.length, local, 0, p)) {
+               packages.push_back(std::move(p));
+            }
+         }
+         ring->consume();
+         enqueue(packages);
+         packages.clear();
+      }
+   }
+   
+   /**
+    Puts the received packages into the queue and notifies the observer once about the data. If acknowledgements
+    are used, the acks bypass the queue: acks from the next node are given to the observer right away, and the acks
+    of the packages received are sent from the socket of this reader. Packages with a sequence number are acknowledged
+    together after a short delay, and the packages which have already arrived are dropped. Packages without
+    a sequence number, from nodes not numbering their packages, are acknowledged one by one.
+    @param packages The packages to move into the queue.
+    */
+   void NetworkReader::enqueue(std::vector<Package> & packages) {
+      if (packages.empty()) {
+         return;
+      }
+      bool queued = false;
+      guard.lock();
+      for (Package & p : packages) {
+         if (sendAckMessages && p.getType() == Package::Acknowledgement) {
+            receivedAcks.push_back(std::move(p));
+         } else if (p.hasSequence()) {
+            const bool numbered = (sendAckMessages && p.getType() == Package::Data);
+            // A package dropped on arrival is not acknowledged, so the sender resends it.
+            // Duplicates are only acknowledged again, so they need no room.
+            if (!(numbered && coalescer.hasArrived(p.originEndpoint(), p.getStream(), p.getSequence()))
+                && !msgQueue.makeRoom(p)) {
+               LOG(INFO) << TAG << "Queue full, dropped package " << p.getUuid();
+               continue;
+            }
+            AckCoalescer::Arrival arrival = AckCoalescer::New;
+            if (numbered) {
+               arrival = coalescer.received(p.originEndpoint(), p.getStream(), p.getSequence(), p.getSequenceBase());
+            }
+            // The sequence number is for the hop from the previous node only.
+            p.setSequence(0, 0);
+            if (arrival == AckCoalescer::Duplicate) {
+               LOG(INFO) << "ackhandling: package " << p.getUuid() << " has already arrived, dropped.";
+            } else if (arrival == AckCoalescer::Overflow) {
+               LOG(INFO) << "ackhandling: package " << p.getUuid() << " too far ahead of the missing packages, dropped.";
+            } else {
+               msgQueue.push(std::move(p));
+               queued = true;
+            }
+         } else if (!msgQueue.makeRoom(p)) {
+            LOG(INFO) << TAG << "Queue full, dropped package " << p.getUuid();
+         } else if (sendAckMessages && p.getType() == Package::Data) {
+            Package ackMessage(boost::uuids::nil_uuid());
+            ackMessage.setType(Package::Type::Acknowledgement);
+            ackMessage.setPayload("ack");
+            ackMessage.setDestination(p.originEndpoint());
+            ackMessage.setUuid(p.getUuid());
+            LOG(INFO) << "ackhandling: prepared an ack message to " << ackMessage.destinationEndpoint();
+            msgQueue.push(std::move(p));
+            queued = true;
+            ackPackages.push_back(std::move(ackMessage));
+         } else {
+            msgQueue.push(std::move(p));
+            queued = true;
+         }
+      }
+      if (sendAckMessages && coalescer.shouldAckNow()) {
+         coalescer.takeAcks(ackPackages, freeSlots());
+      }
+      if (sendAckMessages && coalescer.hasPendingAcks()) {
+         scheduleAcks();
+      }
+      guard.unlock();
+      sendAcks();
+      for (Package & ack : receivedAcks) {
+         observer.receivedAcknowledgement(ack);
+      }
+      receivedAcks.clear();
+      // And when data has been received, notify the observer.
+      if (queued) {
+         observer.receivedData();
+      }
+   }
+   
+   /**
+    Gets the free space for data packages in the queue, given to the senders as credit. With a byte limit,
+    the free bytes are converted to packages by the average size of the packages in the queue.
+    Called holding the guard.
+    @return The number of data packages the queue has space for, or -1 if the queue has no limit.
+    */
+   std::int64_t NetworkReader::freeSlots() const {
+      if (queueLimit == 0 && queueBytes == 0) {
+         return -1;
+      }
+      std::int64_t slots = std::numeric_limits<std::int64_t>::max();
+      if (queueLimit > 0) {
+         const std::size_t queued = msgQueue.size(Package::Data);
+         slots = queued < queueLimit ? static_cast<std::int64_t>(queueLimit - queued) : 0;
+      }
+      if (queueBytes > 0 && !msgQueue.empty()) {
+         const std::size_t averageSize = msgQueue.bytes() / msgQueue.size();
+         const std::size_t freeBytes = msgQueue.bytes() < queueBytes ? queueBytes - msgQueue.bytes() : 0;
+         slots = std::min(slots, static_cast<std::int64_t>(freeBytes / averageSize));
+      }
+      return slots == std::numeric_limits<std::int64_t>::max() ? -1 : slots;
+   }
+   
+   /**
+    Sends the ack packages prepared to the senders of the packages, from the socket of this reader.
+    Acks are sent only for the datagrams received from the socket, so this is called in the thread
+    running the io service of the socket.
+    */
+   void NetworkReader::sendAcks() {
+      if (ackPackages.empty()) {
+         return;
+      }
+      boost::system::error_code ec;
+      for (Package & ack : ackPackages) {
+         // The sender finds the ack by the address and listening port of this node.
+         ack.setOrigin(boost::asio::ip::udp::endpoint(boost::asio::ip::address_v4(), static_cast<unsigned short>(port)));
+         nlohmann::json j = ack;
+         const std::string serialized = j.dump();
+         socket.send_to(boost::asio::buffer(serialized), ack.destinationEndpoint(), 0, ec);
+         if (ec) {
+            LOG(WARNING) << TAG << "Could not send an ack to " << ack.destinationEndpoint() << ": " << ec.message();
+         }
+      }
+      LOG(INFO) << "ackhandling: sent " << ackPackages.size() << " acks.";
+      ackPackages.clear();
+   }
+   
+   /**
+    Starts the ack timer, if it is not already running. When the timer expires, the packages
+    received meanwhile are acknowledged. Called holding the guard, also from the thread reading
+    the queue to send credit updates.
+    */
+   void NetworkReader::scheduleAcks() {
+      if (!ackTimerRunning) {
+         ackTimerRunning = true;
+         ackTimer.expires_after(ACK_DELAY);
+         ackTimer.async_wait(boost::bind(&NetworkReader::handleAckTimer, this, boost::asio::placeholders::error));
+      }
+   }
+   
+   /**
+    Sends the coalesced acks of the packages received since the previous acks to the senders.
+    @param error Tells if the timer was cancelled.
+    */
+   void NetworkReader::handleAckTimer(const boost::system::error_code & error) {
+      guard.lock();
+      ackTimerRunning = false;
+      if (error || !running) {
+         guard.unlock();
+         return;
+      }
+      coalescer.takeAcks(ackPackages, freeSlots());
+      guard.unlock();
+      sendAcks();
+   }
+   
    /** Stops the reader by setting the running flag to false, effectively ending the thread
     loop in the threadFunc(). */
    void NetworkReader::stop() {
       if (running) {
          LOG(INFO) << TAG << "Stop the reader...";
          running = false;
-         LOG(INFO) << TAG << "Shutting down the socket.";
-         socket.cancel();
-         socket.close();
+         if (streamListener) {
+            streamListener->stop();
+         }
+         if (!shards.empty()) {
+            stopShards();
+         }
+         if (ringThread) {
+            ringThread->join();
+            delete ringThread;
+            ringThread = nullptr;
+            ring.reset();
+         }
+         ackTimer.cancel();
+         if (socket.is_open()) {
+            LOG(INFO) << TAG << "Shutting down the socket.";
+            socket.cancel();
+            socket.close();
+         }
+      }
+   }
+   
+   /** How many received packages are waiting in the queue, or in the queues of all the shards.
+    @return Number of packages in the queue. */
+   int NetworkReader::packagesInQueue() const {
+      int count = Networker::packagesInQueue();
+      for (const std::unique_ptr<NetworkReader> & shard : shards) {
+         count += shard->packagesInQueue();
+      }
+      return count;
+   }
+   
+   /** How many received packages have been dropped because the queue was full, in all the shards.
+    @return Number of packages dropped. */
+   unsigned long long NetworkReader::packagesDropped() const {
+      unsigned long long count = Networker::packagesDropped();
+      for (const std::unique_ptr<NetworkReader> & shard : shards) {
+         count += shard->packagesDropped();
       }
+      return count;
    }
    
-   /** Read the package object from the queue, received from the network.
+   /** How many received packages of a type are waiting in the queue, or in the queues of all the shards.
+    @param type The package type.
+    @return Number of packages of the type in the queue. */
+   int NetworkReader::packagesInQueue(Package::Type type) const {
+      int count = Networker::packagesInQueue(type);
+      for (const std::unique_ptr<NetworkReader> & shard : shards) {
+         count += shard->packagesInQueue(type);
+      }
+      return count;
+   }
+   
+   /** Use to query if there are packages other than data in the queue.
+    @return Returns true if control, configuration or ack packages are waiting.
+    */
+   bool NetworkReader::hasPriorityPackages() {
+      std::lock_guard<std::mutex> queueLock(guard);
+      return msgQueue.hasPriorityPackages();
+   }
+   
+   /** Read the package object from the queue, received from the network. Control packages are read
+    before the data packages, from the shards too.
     This method should be called by the NetworkReaderObserver only when it has been notified
     that data has arrived.
     @return The Package containing the data received from the previous ProcessorNode. If queue was empty returns an empty package.
     */
    Package NetworkReader::read() {
+      if (!shards.empty()) {
+         // Control packages in any shard go before the data in the others.
+         for (std::unique_ptr<NetworkReader> & shard : shards) {
+            if (shard->hasPriorityPackages()) {
+               return shard->read();
+            }
+         }
+         // Take the packages from the shards in turns.
+         for (std::size_t count = 0; count < shards.size(); count++) {
+            std::size_t index = (nextShard + count) % shards.size();
+            Package result = shards[index]->read();
+            if (!result.isEmpty()) {
+               nextShard = index + 1;
+               return result;
+            }
+         }
+         return Package(boost::uuids::nil_uuid());
+      }
       LOG(INFO) << TAG << "Reading results from reader";
       guard.lock();
-      Package result;
+      Package result(boost::uuids::nil_uuid());
       if (!msgQueue.empty()) {
-         LOG(INFO) << "METRICS packages in incoming queue: " << msgQueue.size();
+         LOG(INFO) << "METRICS packages in incoming queue: " << msgQueue.size() << ", control: " << msgQueue.size() - msgQueue.size(Package::Data);
          result = std::move(msgQueue.front());
          msgQueue.pop();
+         // Senders given no credit wait until they are told there is space again.
+         if (coalescer.hasStarvedOrigins() && (queueLimit == 0 || msgQueue.size(Package::Data) <= queueLimit / 2)
+             && (queueBytes == 0 || msgQueue.bytes() <= queueBytes / 2)) {
+            coalescer.requestCreditUpdates();
+            scheduleAcks();
+         }
       }
       guard.unlock();
       return result;
@@ -6,6 +6,13 @@
 //  Copyright (c) 2013 Antti Juustila. All rights reserved.
 //
 
+#include <cerrno>
+#include <limits>
+
+#if defined(__linux__)
+#include <sys/socket.h>
+#endif
+
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include <boost/lexical_cast.hpp>
@@ -15,25 +22,32 @@
 #include <g3log/g3log.hpp>
 
 #include <ProcessorNode/NetworkWriter.h>
-
-//TODO handle periodically those packages from sentpackages which have no ack received from next node.
-
+#include <ProcessorNode/Fragmenter.h>
+#include <ProcessorNode/BinaryEnvelope.h>
+#include <ProcessorNode/StreamConnection.h>
+#include <ProcessorNode/SharedMemoryConnection.h>
 
 namespace OHARBase {
 
 const std::string NetworkWriter::TAG{"NetWriter "};
-static const std::chrono::seconds RESEND_PACKAGE_TIMEOUT{10};
+/** Default maximum size of a serialized package. */
+static const std::size_t DEFAULT_MAX_PACKAGE_SIZE{65536};
+/** Default number of packages sent to a destination which may wait for the ack at a time. */
+static const std::size_t DEFAULT_WINDOW{512};
+/** Default number of packages the send queue holds at most before write() waits for space. */
+static const std::size_t DEFAULT_QUEUE_LIMIT{10000};
 
 /**
  Constructor to create the writer with host name. See the
  constructor of Networker class about handling the parameters.
- @param hostName the host to send data to, including port number.
+ @param hostName the host to send data to, including port number. If the address starts with
+ tcp://, packages are sent to it over a TCP connection.
  @param io_s The boost asio io service.
  */
 NetworkWriter::NetworkWriter(const std::string & hostName, boost::asio::io_service & io_s)
-: Networker(hostName,io_s), threader(nullptr), acknowledgePackages(false)
+: Networker(Networker::addressWithoutScheme(hostName),io_s), transport(Networker::transportOf(hostName)), packageDestination(1), pendingBuffers(0), pendingSends(0), maxPackageSize(DEFAULT_MAX_PACKAGE_SIZE), batchSize(1), flushCount(0), flushedPackages(0), threader(nullptr), acknowledgePackages(false), observer(nullptr), window(DEFAULT_WINDOW), heldCount(0), heldBytes(0), heldLimit(DEFAULT_QUEUE_LIMIT), heldByteLimit(0), nextPaced(std::chrono::steady_clock::time_point::max()), format(Format::Json)
 {
-   lastTimeResendWasChecked = std::chrono::system_clock::now();
+   msgQueue.setPackageLimit(DEFAULT_QUEUE_LIMIT);
 }
 
 /**
@@ -44,9 +58,9 @@ NetworkWriter::NetworkWriter(const std::string & hostName, boost::asio::io_servi
  @param io_s The boost asio io service.
  */
 NetworkWriter::NetworkWriter(const std::string & hostName, int portNumber, boost::asio::io_service & io_s)
-: Networker(hostName, portNumber, io_s), threader(nullptr), acknowledgePackages(false)
+: Networker(hostName, portNumber, io_s), transport(Transport::Datagram), packageDestination(1), pendingBuffers(0), pendingSends(0), maxPackageSize(DEFAULT_MAX_PACKAGE_SIZE), batchSize(1), flushCount(0), flushedPackages(0), threader(nullptr), acknowledgePackages(false), observer(nullptr), window(DEFAULT_WINDOW), heldCount(0), heldBytes(0), heldLimit(DEFAULT_QUEUE_LIMIT), heldByteLimit(0), nextPaced(std::chrono::steady_clock::time_point::max()), format(Format::Json)
 {
-   lastTimeResendWasChecked = std::chrono::system_clock::now();
+   msgQueue.setPackageLimit(DEFAULT_QUEUE_LIMIT);
 }
 
 NetworkWriter::~NetworkWriter()
@@ -58,43 +72,126 @@ NetworkWriter::~NetworkWriter()
 /** Thread function which does all the relevant work of sending data packages.
  start() method sets up the networking things, and then threadFunc() is waiting
  for data packages to arrive. When one arrives, it is notified of it (see write()), and then goes
- through a round of a loop. In the loop, a package is taken from the queue, packaged
- in a json data string and then sent over the network. Locks and synchronization are used
+ through a round of a loop. In the loop, up to batchSize packages are taken from the queue, packaged
+ in json data strings and then sent over the network in one flush. Locks and synchronization are used
  to make sure the queue is handled by one thread at a time only. Function quits the loop
  and returns when the stop() is called and the running flag is set to false.
  */
 void NetworkWriter::threadFunc() {
    /*
     What is happening here (can be used to draw an activity diagram)...
-    - set the write's state to running.
     - check if we have an address to send data to
     - while writer is running
-    - if there are messages in the queue
-    read the message package from the queue
-    convert the data from there to JSON
-    determine the address to send data to
-    send it ahead
-    - if there are no messages in the queue
-    wait for someone to awake the thread to send messages.
+    - wait until there are messages in the queue, the writer is stopped or
+    the resend deadline of a sent package passes
+    - with a package log, complete the packages delivered, move the packages
+    spilled to the log into the queue, and flush the log to the disk after
+    releasing the lock
+    - handle the acks received from the next node, and send the packages
+    waiting for the window of their destination to open or for the rate limit
+    - if there are messages in the queue and the packages held for the destinations
+    are below their limit, read a batch of message packages from the queue
+    convert the data from them to JSON
+    determine the addresses to send data to
+    send them ahead in one flush
+    - move the packages not acknowledged before their deadline back to the queue
     - loop to while (above)
     */
-   running = true;
-   if (host.length() > 0 && port > 0) {
+   if (host.length() > 0 && (port > 0 || transport == Transport::SharedMemory)) {
       LOG(INFO) << TAG << "Starting the write loop.";
+      std::vector<Package> batch;
       while (running) {
-         guard.lock();
-         Package package;
-         if (!msgQueue.empty()) {
-            package = msgQueue.front();
-            msgQueue.pop();
-				handlePackage(package);
+         {
+            std::unique_lock<std::mutex> ulock(guard);
+            // Packages to a destination whose window is full or which is over its rate are held for it
+            // alone, and the other destinations get theirs. Data packages are not taken from the queue
+            // only when the held packages are at their limit or a connection is full. Control packages are,
+            // since they are not held.
+            auto hasWork = [this] { return ((!msgQueue.empty() || !spilled.empty()) && (canHoldMore() || msgQueue.hasPriorityPackages())) || !receivedAcks.empty() || !running; };
+            // Wake up for resending packages not acknowledged, and for reopening
+            // connections with packages waiting.
+            auto deadline = std::chrono::steady_clock::time_point::max();
+            if (acknowledgePackages) {
+               deadline = sentPackages.nextDeadline();
+            }
+            if (heldCount > 0) {
+               deadline = std::min(deadline, nextRelease());
+            }
+            if (!rates.isEmpty()) {
+               deadline = std::min(deadline, rates.nextReport());
+            }
+            for (const std::unique_ptr<OutputConnection> & connection : connections) {
+               if (connection->hasPendingFrames()) {
+                  deadline = std::min(deadline, connection->nextConnectAttempt());
+               }
+            }
+            if (deadline != std::chrono::steady_clock::time_point::max()) {
+               condition.wait_until(ulock, deadline, hasWork);
+            } else {
+               LOG(INFO) << TAG << "Send queue empty, waiting...";
+               condition.wait(ulock, hasWork);
+            }
+            acksToHandle.swap(receivedAcks);
+            if (log) {
+               updateLog();
+            }
+            while (running && !msgQueue.empty() && (canHoldMore() || msgQueue.hasPriorityPackages()) && batch.size() < static_cast<std::size_t>(batchSize)) {
+               batch.push_back(std::move(msgQueue.front()));
+               msgQueue.pop();
+            }
+         }
+         if (msgQueue.isLimited() && !batch.empty()) {
+            space.notify_all();
+         }
+         if (!unsyncedRanges.empty()) {
+            PackageLog::sync(unsyncedRanges);
+            unsyncedRanges.clear();
+         }
+         // Acks first, so that the packages acknowledged are not resent.
+         for (const Package & ack : acksToHandle) {
+            handleAcknowledgementMessages(ack);
+         }
+         acksToHandle.clear();
+         if (heldCount > 0) {
+            releaseHeldPackages();
+         }
+         if (!batch.empty()) {
+            handlePackages(batch);
+            batch.clear();
+         } else {
+            flushConnections();
+         }
+         if (acknowledgePackages && sentPackages.nextDeadline() <= std::chrono::steady_clock::now()) {
+            handlePackagesNotAcknowledgedUntilTimeout();
+         }
+         // Packages given up open the window too, and time lets the packages over the rate go.
+         if (heldCount > 0) {
+            releaseHeldPackages();
+         }
+         if (!rates.isEmpty() && rates.nextReport() <= std::chrono::steady_clock::now()) {
+            reportRates();
          }
-         guard.unlock();
 		}
-//      LOG(INFO) << TAG << "Shutting down the network writer thread.";
+      LOG(INFO) << TAG << "Shutting down the network writer thread.";
+   }
+}
+
+/** Handles a batch of packages taken from the send queue. Packages are serialized into the
+ pooled send buffers and then flushed to the socket together.
+ @param packages The packages to handle.
+ */
+void NetworkWriter::handlePackages(std::vector<Package> & packages) {
+   for (const Package & package : packages) {
+      handlePackage(package);
    }
+   flush();
 }
 
+/** Sends a package taken from the send queue to its destinations, or handles it as an ack to this Node.
+ A package whose payload was passed through unparsed and is not valid JSON is dropped when the payload
+ must be parsed, to route the package or to put it into the binary envelope.
+ @param package The package to handle.
+ */
 void NetworkWriter::handlePackage(const Package & package) {
 	if (!package.isEmpty()) {
 		LOG(INFO) << TAG << "Read package from send queue!";
@@ -102,121 +199,548 @@ void NetworkWriter::handlePackage(const Package & package) {
 		// Node (the package has no destination), it is an ack package to this Node.
 		if (acknowledgePackages && package.getType() == Package::Type::Acknowledgement
 			 && !package.hasDestination()) {
-			LOG(INFO) << "ackhandling: ack from " << package.origin();
+			LOG(INFO) << "ackhandling: ack from " << package.originEndpoint();
 			handleAcknowledgementMessages(package);
 		} else {
 			// Otherwise, package is sent away.
-			LOG(INFO) << TAG << "Package read. Now convert to json...";
-			nlohmann::json j = package;
-			currentlySending = j.dump();
-
-			LOG(INFO) << TAG << "Sending: " << currentlySending;
-			if (package.getType() == Package::Data) {
-				sentPackages.push_back(package);
+			// If package has destination address, use it instead of node's configured destination addresses.
+			// Otherwise the first matching routing rule decides, and without a matching rule
+			// the package goes to the configured destinations.
+			const std::vector<boost::asio::ip::udp::endpoint> * targets = &destinations;
+			try {
+				// A payload passed through unparsed is parsed once here for the binary envelope, before
+				// the package is copied for the destinations, so the copies share the parsed payload.
+				if (format == Format::Binary && package.getPayloadRawJson()) {
+					package.getPayloadJson();
+				}
+				if (package.hasDestination()) {
+					LOG(INFO) << "Package specific destination exists.";
+					packageDestination[0] = package.destinationEndpoint();
+					targets = &packageDestination;
+				} else if (!router.isEmpty()) {
+					const std::vector<boost::asio::ip::udp::endpoint> * routed = router.route(package);
+					if (routed) {
+						targets = routed;
+					}
+				}
+			} catch (const nlohmann::json::exception & e) {
+				// The reader checks only that the brackets of a payload passed through match.
+				LOG(WARNING) << TAG << "Package " << package.getUuid() << " has an invalid JSON payload, not sent: " << e.what();
+				if (!logged.empty()) {
+					logSent(package, 0);
+				}
+				return;
 			}
-
-			std::string tmpHost;
-			int tmpPort;
-			// If package has destination address, use it instead of node's configured destination address.
-			tmpHost = host;
-			tmpPort = port;
-			if (package.hasDestination()) {
-				LOG(INFO) << "Package specific destination exists.";
-				std::vector<std::string> strs;
-				boost::split(strs, package.destination(), boost::is_any_of(":"));
-				if (strs.size() == 2) {
-					tmpHost = strs.at(0);
-					tmpPort = std::stoi(strs.at(1));
+			// Packages to the configured destinations are also sent over the connections.
+			const bool toConnections = (targets == &destinations && !connections.empty());
+			// Data packages sent with acks are numbered separately for each destination, so each
+			// destination gets a serialization of its own. Otherwise the package is serialized once
+			// and the same bytes are sent to all the destinations.
+			const bool numbered = (acknowledgePackages && package.getType() == Package::Data && !targets->empty());
+			std::string serialized;
+			if (!numbered || toConnections) {
+				LOG(INFO) << TAG << "Package read. Now serialize it...";
+				serialize(package, serialized);
+				if (serialized.length() > maxPackageSize) {
+					LOG(WARNING) << TAG << "Package of " << serialized.length() << " bytes exceeds the maximum package size " << maxPackageSize << ", not sent.";
+					if (!logged.empty() && !package.hasSequence()) {
+						logSent(package, 0);
+					}
+					return;
+				}
+			}
+			if (toConnections) {
+				for (std::unique_ptr<OutputConnection> & connection : connections) {
+					connection->queue(serialized);
 				}
 			}
-			LOG(INFO) << TAG << "Destination address is " << tmpHost << ":" << tmpPort;
-			LOG(INFO) << TAG << "Creating message...";
-			boost::shared_ptr<std::string> message(new std::string(currentlySending));
-			boost::asio::ip::udp::endpoint destination(boost::asio::ip::address::from_string(tmpHost), tmpPort);
-			LOG(INFO) << TAG << "Now sending to address " << destination.address().to_string() << ":" << destination.port();
-			// Add the packge to sent messages, to be removed when ack is received from next Node.
-			socket.async_send_to(boost::asio::buffer(*message), destination,
-										boost::bind(&NetworkWriter::handleSend, this,
-														boost::asio::placeholders::error,
-														boost::asio::placeholders::bytes_transferred));
-			lastTimeResendWasChecked = std::chrono::system_clock::now();
-			LOG(INFO) << TAG << "Async send delivered";
+			if (numbered) {
+				// Packages sent over connections are not acknowledged, so a resend must not go to them.
+				// With several destinations, each of them must acknowledge the package and
+				// a resend goes only to the destination which did not.
+				const bool perDestination = (targets->size() > 1 || toConnections);
+				const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+				if (!logged.empty() && !package.hasSequence()) {
+					// Delivered when every destination has acknowledged it.
+					logSent(package, targets->size());
+				}
+				for (const boost::asio::ip::udp::endpoint & target : *targets) {
+					Package sent(package);
+					if (perDestination) {
+						sent.setDestination(target);
+					}
+					// A resent package is already in the window, and it is sent even if over the rate.
+					if (!sent.hasSequence() && mustHold(target, true, now)) {
+						LOG(INFO) << TAG << "Window to " << target << " is full or the rate exceeded, holding the package.";
+						hold(target, std::move(sent));
+					} else {
+						sendNumbered(sent, target, now);
+					}
+				}
+			} else if (rates.isEmpty()) {
+				queueDatagrams(package, serialized, targets->data(), targets->size());
+				if (!logged.empty()) {
+					logSent(package, 0);
+				}
+			} else {
+				// Destinations over their rate get the data package later. Control packages are not held.
+				const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+				const bool holdable = (package.getType() == Package::Data || package.getType() == Package::NoType);
+				pacedTargets.clear();
+				std::size_t held = 0;
+				for (const boost::asio::ip::udp::endpoint & target : *targets) {
+					if (holdable && mustHold(target, false, now)) {
+						hold(target, Package(package));
+						held++;
+					} else {
+						rates.take(target, serialized.length(), now);
+						pacedTargets.push_back(target);
+					}
+				}
+				if (!pacedTargets.empty()) {
+					queueDatagrams(package, serialized, pacedTargets.data(), pacedTargets.size());
+				}
+				if (!logged.empty()) {
+					// Delivered when the held packages have been sent too.
+					logSent(package, held);
+				}
+			}
+		}
+	} else if (!logged.empty()) {
+		logSent(package, 0);
+	}
+}
+
+/** Numbers a package, serializes it and puts it into the send buffers to be sent to a destination.
+ The package is added to the sent packages, to be removed when the ack is received from the destination.
+ A package too large to send is not added, so it does not take a sequence number. A resent package was
+ checked when it was first sent, and is added back whatever its size, to be resent or given up.
+ @param package The package to send.
+ @param target The destination.
+ @param now The time the package is sent.
+ */
+void NetworkWriter::sendNumbered(Package & package, const boost::asio::ip::udp::endpoint & target, std::chrono::steady_clock::time_point now) {
+	const bool resend = package.hasSequence();
+	sentPackages.sequence(package, target);
+	std::string serialized;
+	serialize(package, serialized);
+	if (!resend && serialized.length() > maxPackageSize) {
+		LOG(WARNING) << TAG << "Package of " << serialized.length() << " bytes exceeds the maximum package size " << maxPackageSize << ", not sent.";
+		if (!logged.empty()) {
+			logDone(package.getUuid());
 		}
+		return;
+	}
+	sentPackages.add(package, target, now);
+	if (!rates.isEmpty()) {
+		rates.take(target, serialized.length(), now);
+	}
+	queueDatagrams(package, serialized, &target, 1);
+}
+
+/** Serializes a package held for the rate limit and puts it into the send buffers to be sent to a destination.
+ @param package The package to send.
+ @param target The destination.
+ @param now The time the package is sent.
+ */
+void NetworkWriter::sendPaced(const Package & package, const boost::asio::ip::udp::endpoint & target, std::chrono::steady_clock::time_point now) {
+	std::string serialized;
+	serialize(package, serialized);
+	rates.take(target, serialized.length(), now);
+	queueDatagrams(package, serialized, &target, 1);
+	if (!logged.empty()) {
+		logDone(package.getUuid());
+	}
+}
+
+/** Serializes a package in the format of the writer.
+ @param package The package to serialize.
+ @param serialized The serialized package replaces the contents of this string.
+ */
+void NetworkWriter::serialize(const Package & package, std::string & serialized) const {
+	if (format == Format::Binary) {
+		BinaryEnvelope::encode(package, serialized);
+		LOG(INFO) << TAG << "Sending " << serialized.length() << " bytes in the binary envelope";
 	} else {
-		LOG(INFO) << TAG << "Send queue empty, waiting...";
+		dumpJson(package, serialized);
+		LOG(INFO) << TAG << "Sending: " << serialized;
+	}
+}
+
+/** Use to query if a package must wait before it is sent to a destination: because the destination is over
+ its rate limit, or because no more packages may be sent before the earlier ones are acknowledged or the
+ destination gives more credit. Packages already waiting keep their order, so the later ones wait too.
+ Only the copy of the package to this destination waits; the other destinations are not slowed down.
+ @param target The destination.
+ @param numbered True if the package is sent with acks, and limited by the window.
+ @param now The current time.
+ @return Returns true if the package to the destination must wait.
+ */
+bool NetworkWriter::mustHold(const boost::asio::ip::udp::endpoint & target, bool numbered, std::chrono::steady_clock::time_point now) {
+	auto held = heldPackages.find(target);
+	if (held != heldPackages.end() && !held->second.empty()) {
+		return true;
+	}
+	if (numbered && sentPackages.inFlight(target) >= windowOf(target)) {
+		return true;
+	}
+	return !rates.isEmpty() && !rates.isAvailable(target, now);
+}
+
+/** Gets how many packages sent to a destination may wait for the ack at a time: the window, or less if the
+ destination has given less credit.
+ @param target The destination.
+ @return The number of packages.
+ */
+std::size_t NetworkWriter::windowOf(const boost::asio::ip::udp::endpoint & target) const {
+	return std::min(window > 0 ? window : std::numeric_limits<std::size_t>::max(), sentPackages.credit(target));
+}
+
+/** Holds a package for a destination until its window opens or it is below its rate again.
+ @param target The destination.
+ @param package The package to hold.
+ */
+void NetworkWriter::hold(const boost::asio::ip::udp::endpoint & target, Package && package) {
+	heldBytes += PackageQueue::sizeOf(package);
+	heldCount++;
+	heldPackages[target].push_back(std::move(package));
+}
+
+/** Use to query if more data packages may be taken from the queue, to be held if their destinations
+ cannot take them now. The held packages are limited like the send queue, so a destination not acknowledging
+ the packages or a low rate limit stops the other destinations only when the limit is reached. The packages
+ waiting in a connection are limited by the connection in the same way.
+ @return Returns true if the held packages are below the limits and no connection is full.
+ */
+bool NetworkWriter::canHoldMore() const {
+	if (!((heldLimit == 0 || heldCount < heldLimit) && (heldByteLimit == 0 || heldBytes < heldByteLimit))) {
+		return false;
+	}
+	for (const std::unique_ptr<OutputConnection> & connection : connections) {
+		if (connection->isFull()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/** Wakes up the writer thread when a connection which was full has sent packages, so that it takes
+ data packages from the queue again. Called from the thread of the connection.
+ */
+void NetworkWriter::connectionDrained() {
+	{
+		std::lock_guard<std::mutex> lock(guard);
+	}
+	condition.notify_all();
+}
+
+/** Sends the held packages, as many as the window and the rate limit of each destination allow now,
+ and sets the time when packages over the rate may be sent next. A destination with no credit is sent
+ a probe package now and then. */
+void NetworkWriter::releaseHeldPackages() {
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	std::size_t released = 0;
+	nextPaced = std::chrono::steady_clock::time_point::max();
+	for (auto & held : heldPackages) {
+		const boost::asio::ip::udp::endpoint & target = held.first;
+		std::deque<Package> & packages = held.second;
+		while (!packages.empty()) {
+			if (!rates.isEmpty() && !rates.isAvailable(target, now)) {
+				nextPaced = std::min(nextPaced, rates.availableAt(target));
+				break;
+			}
+			Package & package = packages.front();
+			if (acknowledgePackages && package.getType() == Package::Data) {
+				if (sentPackages.inFlight(target) >= windowOf(target) && !sentPackages.probe(target, now)) {
+					break;
+				}
+			}
+			// Counted before sending, since serializing may parse a payload passed through and change its size.
+			heldBytes -= PackageQueue::sizeOf(package);
+			if (acknowledgePackages && package.getType() == Package::Data) {
+				sendNumbered(package, target, now);
+			} else {
+				sendPaced(package, target, now);
+			}
+			packages.pop_front();
+			released++;
+		}
+	}
+	if (released > 0) {
+		heldCount -= released;
+		LOG(INFO) << TAG << "Sending " << released << " held packages, " << heldCount << " still held.";
+		flush();
+	}
+}
+
+/** Gets the time when held packages may be sent next, if they are not waiting for acks.
+ @return The time of the next probe or the time when a destination is below its rate again,
+ or the maximum time point if the held packages wait for acks only.
+ */
+std::chrono::steady_clock::time_point NetworkWriter::nextRelease() const {
+	if (acknowledgePackages) {
+		return std::min(nextPaced, sentPackages.nextProbe());
+	}
+	return nextPaced;
+}
+
+/** Reports the rates sent to the destinations with a rate limit to the observer, with the packages
+ waiting for each destination: the packages held for it, and the packages in the send queue, which
+ have not been sent to any destination yet. */
+void NetworkWriter::reportRates() {
+	measuredRates.clear();
+	rates.takeRates(std::chrono::steady_clock::now(), measuredRates);
+	if (observer) {
+		std::size_t queued = 0;
 		{
-			std::unique_lock<std::mutex> ulock(guard);
-			condition.wait(ulock, [this] {return !msgQueue.empty() || !running; } );
+			std::lock_guard<std::mutex> queueLock(guard);
+			queued = msgQueue.size();
 		}
-		if (timeToCheckPackagesToResend()) {
-			handlePackagesNotAcknowledgedUntilTimeout();
+		for (const RateLimiter::Rate & rate : measuredRates) {
+			auto held = heldPackages.find(rate.target);
+			observer->sendRate(rate.target, rate.packages, rate.bytes, queued + (held != heldPackages.end() ? held->second.size() : 0));
 		}
 	}
 }
 
+/** Puts a serialized package into the send buffers to be sent to the destinations in the next flush.
+ Serialized bytes are put into the send buffers once and shared by all the destinations.
+ @param package The package, for the uuid of the fragments.
+ @param serialized The serialized package. The contents are moved into the send buffers.
+ @param targets The destinations.
+ @param targetCount How many destinations there are.
+ */
+void NetworkWriter::queueDatagrams(const Package & package, std::string & serialized, const boost::asio::ip::udp::endpoint * targets, std::size_t targetCount) {
+	// With only connections as outputs, there is nothing to send the datagrams to.
+	if (targetCount == 0) {
+		return;
+	}
+	if (serialized.length() > BufferSize) {
+		// Too large for one datagram, so send the package in fragments the receiver puts back together.
+		fragments.clear();
+		Fragmenter::split(package.getUuid(), serialized, BufferSize, fragments);
+		LOG(INFO) << TAG << "Sending the package in " << fragments.size() << " fragments";
+		for (std::string & fragment : fragments) {
+			std::size_t bufferIndex = addSendBuffer(fragment);
+			for (std::size_t target = 0; target < targetCount; target++) {
+				queueDatagram(bufferIndex, targets[target]);
+			}
+		}
+	} else {
+		std::size_t bufferIndex = addSendBuffer(serialized);
+		for (std::size_t target = 0; target < targetCount; target++) {
+			LOG(INFO) << TAG << "Destination address is " << targets[target];
+			queueDatagram(bufferIndex, targets[target]);
+		}
+	}
+}
+
+/** Puts a serialized package, or a fragment of one, into the pooled send buffers to be sent in the next flush.
+ @param data The datagram to send. The contents are moved into the send buffer.
+ @return The index of the send buffer holding the data.
+ */
+std::size_t NetworkWriter::addSendBuffer(std::string & data) {
+   if (sendBuffers.size() <= pendingBuffers) {
+      sendBuffers.resize(pendingBuffers + 1);
+   }
+   sendBuffers[pendingBuffers].swap(data);
+   return pendingBuffers++;
+}
+
+/** Queues a send buffer to be sent to a destination in the next flush. The same buffer
+ may be sent to several destinations.
+ @param bufferIndex The index of the send buffer to send.
+ @param destination Where to send the datagram to.
+ */
+void NetworkWriter::queueDatagram(std::size_t bufferIndex, const boost::asio::ip::udp::endpoint & destination) {
+   if (sendMessages.size() <= pendingSends) {
+      sendMessages.resize(pendingSends + 1);
+   }
+   sendMessages[pendingSends] = std::make_pair(bufferIndex, destination);
+   pendingSends++;
+}
+
+/** Sends the serialized packages waiting in the pooled send buffers. In Linux, all the
+ packages are sent with one sendmmsg call, in other systems one by one.
+ */
+void NetworkWriter::flush() {
+   if (pendingSends == 0) {
+      pendingBuffers = 0;
+      flushConnections();
+      return;
+   }
+   std::size_t sent = 0;
+#if defined(__linux__)
+   std::vector<mmsghdr> messages(pendingSends);
+   std::vector<iovec> vectors(pendingSends);
+   for (std::size_t index = 0; index < pendingSends; index++) {
+      const std::string & data = sendBuffers[sendMessages[index].first];
+      vectors[index].iov_base = const_cast<char*>(data.data());
+      vectors[index].iov_len = data.length();
+      messages[index] = mmsghdr{};
+      messages[index].msg_hdr.msg_iov = &vectors[index];
+      messages[index].msg_hdr.msg_iovlen = 1;
+      messages[index].msg_hdr.msg_name = sendMessages[index].second.data();
+      messages[index].msg_hdr.msg_namelen = static_cast<socklen_t>(sendMessages[index].second.size());
+   }
+   while (sent < pendingSends) {
+      int count = ::sendmmsg(socket.native_handle(), messages.data() + sent, static_cast<unsigned int>(pendingSends - sent), 0);
+      if (count < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         LOG(WARNING) << TAG << "Cannot send data to next node! " << errno;
+         // Skip the message that failed and try the rest.
+         sent++;
+      } else {
+         sent += static_cast<std::size_t>(count);
+      }
+   }
+#else
+   for (; sent < pendingSends; sent++) {
+      boost::system::error_code ec;
+      socket.send_to(boost::asio::buffer(sendBuffers[sendMessages[sent].first]), sendMessages[sent].second, 0, ec);
+      LOG_IF(WARNING, (ec != boost::system::errc::success)) << TAG << "Cannot send data to next node! " << ec.value();
+   }
+#endif
+   flushCount++;
+   flushedPackages += pendingSends;
+   LOG(INFO) << "METRICS packages per flush: " << pendingSends << " average: " << static_cast<double>(flushedPackages) / flushCount;
+   pendingSends = 0;
+   pendingBuffers = 0;
+   flushConnections();
+}
+
+/** Writes the packages queued for the connections. A shared memory ring which is not open is
+ opened again when its retry time has passed; a TCP connection is opened again by its own thread.
+ */
+void NetworkWriter::flushConnections() {
+   for (std::unique_ptr<OutputConnection> & connection : connections) {
+      connection->flush();
+   }
+}
+
 /** Handles the ack messsage packages from previous node. Finds the sent message
- from the sentPackages queue and if found, and package acknowledged, removes it.
+ from the sentPackages table and if found, and package acknowledged, removes it.
  @param package The package to find and erase. Package must be an ack/nack package.
  */
 void NetworkWriter::handleAcknowledgementMessages(const Package & package) {
    LOG(INFO) << "ackhandling: checking if ack message relates to sent message in sent container";
-   bool packageFound = false;
-   for (std::vector<Package>::iterator iter = sentPackages.begin();
-        iter < sentPackages.end(); iter++) {
-      if (*iter == package) {
-         packageFound = true;
-         if (package.getPayloadString() == "ack") {
-            sentPackages.erase(iter);
-            LOG(INFO) << "ackhandling: sent package removed due to ack received.";
-            break;
-         } else {
-            LOG(INFO) << "ackhandling: ack is " << package.getPayloadString() << " so not acked nor removed from sent.";
-            break;
-         }
+   SequenceAck ack;
+   std::vector<boost::uuids::uuid> * uuids = logged.empty() ? nullptr : &acknowledgedUuids;
+   if (ack.fromPayload(package.getPayloadString())) {
+      // One ack for all the packages of a stream received by the next node.
+      std::size_t acknowledged = sentPackages.acknowledge(ack, std::chrono::steady_clock::now(), uuids);
+      LOG(INFO) << "ackhandling: " << acknowledged << " sent packages acknowledged in stream " << ack.stream;
+   } else if (sentPackages.acknowledge(package, std::chrono::steady_clock::now(), uuids)) {
+      LOG(INFO) << "ackhandling: sent package found for the ack.";
+   } else {
+      LOG(INFO) << "ackhandling: package ack'ed was not found in sent packages!";
+   }
+   if (uuids) {
+      for (const boost::uuids::uuid & uuid : acknowledgedUuids) {
+         logDone(uuid);
       }
+      acknowledgedUuids.clear();
    }
-   if (!packageFound) {
-      LOG(INFO) << "ackhandling: package ack'ed was not found in sent packages!";
+}
+
+/** Resends the sent packages not acknowledged before their deadline. Packages resent the
+ maximum number of times are given up and the observer is notified of them. */
+void NetworkWriter::handlePackagesNotAcknowledgedUntilTimeout() {
+   expiredPackages.clear();
+   givenUpPackages.clear();
+   sentPackages.takeExpired(std::chrono::steady_clock::now(), expiredPackages, givenUpPackages);
+   if (running && !expiredPackages.empty()) {
+      LOG(INFO) << "ackhandling:  has " << expiredPackages.size() << " packages not ack'ed in time, resending.";
+      for (const Package & package : expiredPackages) {
+         handlePackage(package);
+      }
+      flush();
+   }
+   for (const Package & package : givenUpPackages) {
+      LOG(WARNING) << TAG << "ackhandling: package " << package.getUuid() << " to " << package.destinationEndpoint() << " not acknowledged, giving up.";
+      if (observer) {
+         observer->packageNotDelivered(package, sentPackages.getMaxResends() + 1);
+      }
+      // The observer has been told, so the package is not sent again after a restart either.
+      if (!logged.empty()) {
+         logDone(package.getUuid());
+      }
    }
+   expiredPackages.clear();
+   givenUpPackages.clear();
 }
 
-bool NetworkWriter::timeToCheckPackagesToResend() {
-   if (std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now() - lastTimeResendWasChecked) > RESEND_PACKAGE_TIMEOUT) {
-      LOG(INFO) << "ackhandling:  it is time to check if packages should be resent";
-      return true;
+/** Completes the packages delivered in the log, puts the packages spilled to the log into the send queue
+ as it has space, and takes the records to flush to the disk. The writer thread flushes them after releasing
+ the guard, so the handlers writing packages do not wait for the disk, and before the packages taken from
+ the queue are sent, so a package delivered is on the disk. One flush covers all the packages written
+ since the previous batch. Called by the writer thread with the guard locked.
+ */
+void NetworkWriter::updateLog() {
+   for (std::uint64_t id : completedIds) {
+      log->complete(id);
+   }
+   completedIds.clear();
+   for (const auto & written : writtenIds) {
+      if (!logged.emplace(written.first, Logged{written.second, 0}).second) {
+         // Another package with the same uuid is waiting, and that one is delivered instead.
+         log->complete(written.second);
+      }
+   }
+   writtenIds.clear();
+   Package package(boost::uuids::nil_uuid());
+   while (!spilled.empty()) {
+      const std::uint64_t id = spilled.front();
+      if (!log->read(id, package)) {
+         log->complete(id);
+         spilled.pop_front();
+         continue;
+      }
+      if (!msgQueue.hasSpaceFor(package)) {
+         break;
+      }
+      if (!logged.emplace(package.getUuid(), Logged{id, 0}).second) {
+         log->complete(id);
+      }
+      msgQueue.push(std::move(package));
+      spilled.pop_front();
    }
-   LOG(INFO) << "ackhandling: not yet time to check if packages should be resent";
-   return false;
+   log->takeUnsynced(unsyncedRanges);
 }
 
-/** Goes through all the sent packages and resends them by moving them into the msgQueue. */
-void NetworkWriter::handlePackagesNotAcknowledgedUntilTimeout() {
-   if (running && sentPackages.size() > 0) {
-      LOG(INFO) << "ackhandling:  has " << sentPackages.size() << " packages not ack'ed to send, moving to send queue.";
-      guard.lock();
-      for (Package & package : sentPackages) {
-         msgQueue.push(package);
+/** Sets how many sends a package taken from the send queue waits for before it is delivered.
+ A package not in the log is ignored.
+ @param package The package.
+ @param pending The number of destinations to acknowledge the package, or the number of packages held
+ for the rate. With 0, the package has been delivered.
+ */
+void NetworkWriter::logSent(const Package & package, std::size_t pending) {
+   auto found = logged.find(package.getUuid());
+   if (found != logged.end()) {
+      found->second.pending = pending;
+      if (pending == 0) {
+         completedIds.push_back(found->second.id);
+         logged.erase(found);
       }
-      guard.unlock();
-      sentPackages.clear();
-      LOG(INFO) << "ackhandling: moved sent packages not ack'ed to send queue.";
-      //condition.notify_one();
-   } else {
-      LOG(INFO) << "ackhandling: no packages in sent container.";
    }
-   lastTimeResendWasChecked = std::chrono::system_clock::now();
 }
 
-/** This method is called when the boost async send finishes.
- @param error Result code of sending, might be an error.
- @param bytes_transferred How many bytes were sent. */
-void NetworkWriter::handleSend(const boost::system::error_code& error,
-                               std::size_t bytes_transferred)
-{
-   if (error != boost::system::errc::success) {
-      LOG(WARNING) << TAG << "Cannot send data to next node! " << error.value();
-   } else {
-      LOGF(INFO, "Sent %lu bytes through socket.", bytes_transferred);
+/** Counts a destination to have acknowledged a package, or a held package to have been sent. When nothing
+ remains, the package is completed in the log.
+ @param uuid The uuid of the package.
+ */
+void NetworkWriter::logDone(const boost::uuids::uuid & uuid) {
+   auto found = logged.find(uuid);
+   if (found != logged.end()) {
+      if (found->second.pending > 0) {
+         found->second.pending--;
+      }
+      if (found->second.pending == 0) {
+         completedIds.push_back(found->second.id);
+         logged.erase(found);
+      }
    }
 }
 
@@ -230,6 +754,46 @@ void NetworkWriter::start(bool useAcknowledgements) {
    if (!running) {
       LOG(INFO) << TAG << "Starting NetworkWriter.";
       socket.open(boost::asio::ip::udp::v4());
+      destinations.clear();
+      connections.clear();
+      if (transport == Transport::SharedMemory) {
+         connections.emplace_back(new SharedMemoryConnection(host));
+      } else if (host.length() > 0 && port > 0) {
+         boost::system::error_code ec;
+         boost::asio::ip::address address = boost::asio::ip::address::from_string(host, ec);
+         if (!ec) {
+            if (transport == Transport::Stream) {
+               connections.emplace_back(new StreamConnection(host, port, [this] { connectionDrained(); }));
+            } else {
+               destinations.emplace_back(address, port);
+            }
+         }
+      }
+      for (const std::string & hostName : additionalDestinations) {
+         if (Networker::transportOf(hostName) == Transport::SharedMemory) {
+            connections.emplace_back(new SharedMemoryConnection(Networker::addressWithoutScheme(hostName)));
+            continue;
+         }
+         std::vector<std::string> strs;
+         boost::split(strs, Networker::addressWithoutScheme(hostName), boost::is_any_of(":"));
+         if (strs.size() == 2) {
+            if (Networker::transportOf(hostName) == Transport::Stream) {
+               connections.emplace_back(new StreamConnection(strs.at(0), std::stoi(strs.at(1)), [this] { connectionDrained(); }));
+            } else {
+               destinations.emplace_back(boost::asio::ip::address::from_string(strs.at(0)), std::stoi(strs.at(1)));
+            }
+         }
+      }
+      LOG(INFO) << TAG << "Sending packages to " << destinations.size() << " UDP and " << connections.size() << " other destinations.";
+      if (!logDirectory.empty()) {
+         // The packages not delivered before the writer was stopped are sent first.
+         log.reset(new PackageLog(logDirectory));
+         std::vector<std::uint64_t> pending;
+         log->pendingIds(pending);
+         spilled.assign(pending.begin(), pending.end());
+         LOG(INFO) << TAG << "Sending again " << spilled.size() << " packages from the log.";
+      }
+      running = true;
       threader = new std::thread(&NetworkWriter::threadFunc, this);
    }
 }
@@ -240,36 +804,102 @@ void NetworkWriter::stop() {
    if (running) {
       LOG(INFO) << "METRICS packages in outgoing queue: " << msgQueue.size();
       LOG(INFO) << "METRICS packages in not acked sent queue: " << sentPackages.size();
+      guard.lock();
       running = false;
-      while (!msgQueue.empty()) {
-         msgQueue.pop();
-      }
-      sentPackages.clear();
-      socket.cancel();
-      socket.close();
+      msgQueue.clear();
+      guard.unlock();
+      space.notify_all();
+      // Wake up the writer thread so that it notices the writer is stopped and exits.
+      // The connections stop connecting and writing, and a write blocked on a ring not read is interrupted.
       condition.notify_all();
+      for (std::unique_ptr<OutputConnection> & connection : connections) {
+         connection->interrupt();
+      }
       if (threader->joinable()) {
-         threader->detach();
+         threader->join();
       }
       delete threader;
       threader = nullptr;
+      sentPackages.clear();
+      receivedAcks.clear();
+      heldPackages.clear();
+      heldCount = 0;
+      heldBytes = 0;
+      if (log) {
+         // The packages not yet delivered stay in the log for the next start.
+         for (std::uint64_t id : completedIds) {
+            log->complete(id);
+         }
+         LOG(INFO) << TAG << log->pendingCount() << " packages not delivered left in the log.";
+         log.reset();
+         completedIds.clear();
+         logged.clear();
+         writtenIds.clear();
+         spilled.clear();
+      }
+      connections.clear();
+      socket.cancel();
+      socket.close();
    }
    LOG(INFO) << TAG << "Exiting NetworkWriter::stop.";
 }
 
 
-/** Use write to send packages to the next ProcessorNode. The package is
- put into a queue of packages to send and will be sent when all the previous packages
- have been sent by the threadFunc().
+/** Use write to send packages to the next ProcessorNode. A copy of the package,
+ sharing the payload with it, is put into the send queue as in write(Package &&).
  @param data The data package to send.
  */
 void NetworkWriter::write(const Package & data)
+{
+   write(Package(data));
+}
+
+/** Use write to send packages to the next ProcessorNode. The package is moved and
+ put into a queue of packages to send and will be sent when all the previous packages
+ of its type have been sent by the threadFunc(). Control packages are sent before the
+ data packages in the queue. If the queue has a limit and it is full, the overflow policy
+ of the queue applies. With the block policy, waits until there is space for a data package,
+ so that the caller is slowed down to the pace the next node takes packages; other packages
+ never wait. With the drop policies, the package or the packages in the queue are dropped.
+ @param data The data package to send.
+ */
+void NetworkWriter::write(Package && data)
 {
    if (running) {
       LOG(INFO) << TAG << "Putting data to networkwriter's message queue.";
-      guard.lock();
-      msgQueue.push(data);
-      guard.unlock();
+      std::unique_lock<std::mutex> ulock(guard);
+      // Logged data packages never wait nor are dropped: over the queue limit, they wait in the log only.
+      // A package with the uuid of a package already waiting is sent but not logged again.
+      if (log && data.getType() == Package::Data && writtenIds.count(data.getUuid()) == 0) {
+         try {
+            const std::uint64_t id = log->append(data);
+            if (spilled.empty() && msgQueue.hasSpaceFor(data)) {
+               writtenIds.emplace(data.getUuid(), id);
+               msgQueue.push(std::move(data));
+            } else {
+               LOG(INFO) << TAG << "Send queue is full, package " << data.getUuid() << " spilled to the log.";
+               spilled.push_back(id);
+            }
+            ulock.unlock();
+            condition.notify_one();
+            return;
+         } catch (const std::runtime_error & e) {
+            LOG(WARNING) << TAG << "Cannot write the package to the log: " << e.what();
+         }
+      }
+      if (data.getType() == Package::Data && msgQueue.getOverflow() == PackageQueue::Overflow::Block && !msgQueue.hasSpaceFor(data)) {
+         LOG(INFO) << TAG << "Send queue is full, waiting for space.";
+         space.wait(ulock, [this, &data] { return msgQueue.hasSpaceFor(data) || !running; });
+         if (!running) {
+            return;
+         }
+      }
+      if (!msgQueue.makeRoom(data)) {
+         LOG(INFO) << TAG << "Send queue is full, dropped package " << data.getUuid();
+         return;
+      }
+      msgQueue.push(std::move(data));
+      ulock.unlock();
       LOG(INFO) << "METRICS packages in outgoing queue: " << msgQueue.size();
       LOG(INFO) << "METRICS packages in not acked sent queue: " << sentPackages.size();
       // Notify the writer thread there's something to send.
@@ -277,5 +907,205 @@ void NetworkWriter::write(const Package & data)
    }
 }
 
+/** Gives an ack received from the next node to the writer. The ack is not put into the send queue
+ but handled by the writer thread before the packages waiting there, so that acks are not delayed
+ by the packages to send.
+ @param ack The ack package.
+ */
+void NetworkWriter::acknowledge(const Package & ack)
+{
+   if (running && acknowledgePackages) {
+      guard.lock();
+      receivedAcks.push_back(ack);
+      guard.unlock();
+      condition.notify_one();
+   }
+}
+
+/**
+ Adds a destination address to send packages to, in addition to the host address given in
+ the constructor. Packages without a package specific destination are sent to all destinations.
+ Must be called before start().
+ @param hostName The address to send data to, including the port number, e.g. 130.231.99.123:3344.
+ Addresses starting with tcp://, e.g. tcp://130.231.99.123:3344, are sent to over a TCP connection,
+ and addresses starting with shm://, e.g. shm://filter2, through a shared memory ring.
+ */
+void NetworkWriter::addDestination(const std::string & hostName) {
+   additionalDestinations.push_back(hostName);
+}
+
+/**
+ Gets the number of destinations packages are sent to.
+ @return The number of destination addresses.
+ */
+std::size_t NetworkWriter::destinationCount() const {
+   return 1 + additionalDestinations.size();
+}
+
+/**
+ Sets the routing rules used to select the destinations of packages by their contents.
+ See PackageRouter for the syntax of the rules. Must be called before start().
+ @param rules The routing rules.
+ @throws std::runtime_error if the rules cannot be parsed.
+ */
+void NetworkWriter::setRoutes(const std::string & rules) {
+   router.parse(rules);
+}
+
+/**
+ Sets the observer notified of the packages the writer could not deliver. Must be called before start().
+ @param obs The observer, or null.
+ */
+void NetworkWriter::setObserver(NetworkWriterObserver * obs) {
+   observer = obs;
+}
+
+/**
+ Sets how many times a package not acknowledged by the next node is resent before it is given up.
+ Must be called before start().
+ @param resends The number of resends.
+ */
+void NetworkWriter::setMaxResends(int resends) {
+   sentPackages.setMaxResends(resends);
+}
+
+/**
+ Sets how many packages sent to one destination may wait for the ack at a time, when acks are used.
+ When the window is full, the packages to the destination are held until it acknowledges earlier ones,
+ while the other destinations are sent to. The held packages are limited like the send queue.
+ @param packages The size of the window, 0 for no limit.
+ */
+void NetworkWriter::setWindow(std::size_t packages) {
+   window = packages;
+}
+
+/**
+ Gets how many packages sent to one destination may wait for the ack at a time.
+ @return The size of the window, 0 for no limit.
+ */
+std::size_t NetworkWriter::getWindow() const {
+   return window;
+}
+
+/**
+ Sets the rate limits of the destinations. See RateLimiter for the syntax. Must be called before start().
+ @param limits The rate limits.
+ @throws std::runtime_error if the limits cannot be parsed.
+ */
+void NetworkWriter::setRates(const std::string & limits) {
+   rates.parse(limits);
+}
+
+/**
+ Sets the directory of the package log. The data packages written are kept in the log until delivered:
+ until every destination has acknowledged them, or until sent when acks are not used. When the writer is
+ started, the packages left in the log are sent first, so packages are not lost when the node is stopped
+ or crashes, but may be delivered twice. When the send queue is full, data packages are spilled to the log
+ instead of applying the overflow policy. Must be called before start().
+ @param directory The directory of the log, created if it does not exist. Empty for no log.
+ */
+void NetworkWriter::setLog(const std::string & directory) {
+   logDirectory = directory;
+}
+
+/**
+ Sets how many packages the send queue holds at most. When the queue is full, the overflow policy
+ applies. The packages held for destinations whose window is full or which are over their rate are
+ limited to the same number, and data packages are not taken from the queue while they are at the limit.
+ Must be called before start().
+ @param packages The maximum number of packages in the queue, 0 for no limit.
+ */
+void NetworkWriter::setQueueLimit(std::size_t packages) {
+   msgQueue.setPackageLimit(packages);
+   heldLimit = packages;
+}
+
+/**
+ Sets how many bytes of packages the send queue holds at most. When the queue is full, the overflow
+ policy applies. The held packages are limited to the same size. Must be called before start().
+ @param bytes The maximum size of the packages in the queue, 0 for no limit.
+ */
+void NetworkWriter::setQueueBytes(std::size_t bytes) {
+   msgQueue.setByteLimit(bytes);
+   heldByteLimit = bytes;
+}
+
+/**
+ Sets what is done when the send queue is full. With PackageQueue::Overflow::Block, write() waits until
+ the writer has taken packages from the queue. Must be called before start().
+ @param policy The overflow policy.
+ */
+void NetworkWriter::setOverflow(PackageQueue::Overflow policy) {
+   msgQueue.setOverflow(policy);
+}
+
+/**
+ Sets the format the packages are sent in. Receivers accept both formats, so a node may send
+ in the binary format to nodes which send in JSON. Must be called before start().
+ @param packageFormat The format.
+ */
+void NetworkWriter::setFormat(Format packageFormat) {
+   format = packageFormat;
+}
+
+/**
+ Gets the format the packages are sent in.
+ @return The format.
+ */
+Networker::Format NetworkWriter::getFormat() const {
+   return format;
+}
+
+/**
+ Sets how many packages the writer takes from the queue at most and sends in one flush.
+ @param size The maximum number of packages in a flush. Values smaller than 1 are treated as 1.
+ */
+void NetworkWriter::setBatchSize(int size) {
+   batchSize = std::max(1, size);
+}
+
+/**
+ Gets the maximum number of packages sent in one flush.
+ @return The batch size.
+ */
+int NetworkWriter::getBatchSize() const {
+   return batchSize;
+}
+
+/**
+ Sets the maximum size of a serialized package. Packages larger than what fits into one datagram
+ are split into fragments and put back together by the receiving NetworkReader. Packages larger than
+ the maximum size are not sent.
+ @param size The maximum package size in bytes.
+ */
+void NetworkWriter::setMaxPackageSize(std::size_t size) {
+   maxPackageSize = size;
+}
+
+/**
+ Gets the maximum size of a serialized package.
+ @return The maximum package size in bytes.
+ */
+std::size_t NetworkWriter::getMaxPackageSize() const {
+   return maxPackageSize;
+}
+
+/**
+ Gets how many times the writer has flushed packages to the socket.
+ Together with getFlushedPackageCount() tells how many packages are sent per flush on average.
+ @return The number of flushes.
+ */
+unsigned long long NetworkWriter::getFlushCount() const {
+   return flushCount;
+}
+
+/**
+ Gets how many packages the writer has flushed to the socket in total.
+ @return The number of packages sent.
+ */
+unsigned long long NetworkWriter::getFlushedPackageCount() const {
+   return flushedPackages;
+}
+
 
 } //namespace
@@ -8,11 +8,17 @@
 
 #include <boost/algorithm/string.hpp>
 #include <vector>
+#include <stdexcept>
 
 #include <ProcessorNode/Networker.h>
 
 namespace OHARBase {
 	
+	/** Addresses starting with this use the stream (TCP) transport. */
+	static const std::string StreamScheme{"tcp://"};
+	/** Addresses starting with this use the shared memory transport. */
+	static const std::string SharedMemoryScheme{"shm://"};
+	
 	
 	/**
 	 Constructor for a networking object.
@@ -26,7 +32,7 @@ namespace OHARBase {
     @param io_s The boost asio io service.
 	 */
 	Networker::Networker(const std::string & hostName, boost::asio::io_service & io_s)
-	:	running(false), socket(io_s)
+	:	port(0), running(false), socket(io_s)
 	{
 		setHost(hostName);
 		buffer = std::shared_ptr<boost::array<char, BufferSize>>(new boost::array<char, BufferSize>());
@@ -59,6 +65,19 @@ namespace OHARBase {
       return msgQueue.size();
    }
 
+   /** How many packages of a type are there in the sending/receiving queue.
+    @param type The package type.
+    @return Number of packages of the type in the queue. */
+   int Networker::packagesInQueue(Package::Type type) const {
+      return msgQueue.size(type);
+   }
+
+   /** How many packages have been dropped because the sending/receiving queue was full.
+    @return Number of packages dropped. */
+   unsigned long long Networker::packagesDropped() const {
+      return msgQueue.dropped();
+   }
+
 	/**
 	 Is the networker running or not (has it been start()'ed or not).
 	 @return true, if the networker is running (reading or ready to send).
@@ -67,6 +86,50 @@ namespace OHARBase {
 		return running;
 	}
 	
+	/**
+	 Gets the transport an address in the configuration uses.
+	 @param address The address, e.g. 130.231.98.123:1111, tcp://130.231.98.123:1111, tcp://1111 or shm://name.
+	 @return Transport::Stream if the address starts with tcp://, Transport::SharedMemory if it starts
+	 with shm://, otherwise Transport::Datagram.
+	 */
+	Networker::Transport Networker::transportOf(const std::string & address) {
+		if (boost::starts_with(address, StreamScheme)) {
+			return Transport::Stream;
+		}
+		if (boost::starts_with(address, SharedMemoryScheme)) {
+			return Transport::SharedMemory;
+		}
+		return Transport::Datagram;
+	}
+	
+	/**
+	 Removes the transport scheme (e.g. tcp://) from the beginning of an address.
+	 @param address The address, possibly starting with a scheme.
+	 @return The address without the scheme.
+	 */
+	std::string Networker::addressWithoutScheme(const std::string & address) {
+		std::size_t pos = address.find("://");
+		if (pos != std::string::npos) {
+			return address.substr(pos + 3);
+		}
+		return address;
+	}
+	
+	/**
+	 Gets the package format by its name in the node configuration.
+	 @param format The name: json or binary.
+	 @return The format.
+	 @throws std::runtime_error if the name is not a format.
+	 */
+	Networker::Format Networker::formatFrom(const std::string & format) {
+		if (format == "json") {
+			return Format::Json;
+		} else if (format == "binary") {
+			return Format::Binary;
+		}
+		throw std::runtime_error("Unknown package format: " + format);
+	}
+	
 	/**
 	 Sets the host IP address of the networking object.
 	 @param hostName The address of the host (IPv4 number format, e.g. 130.231.98.123:1111).
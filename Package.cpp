@@ -6,16 +6,13 @@
 //  Copyright (c) 2013 Antti Juustila. All rights reserved.
 //
 
-#include <vector>
-
-
-#include <boost/algorithm/string.hpp>
 #include <boost/uuid/uuid_io.hpp>
 
 #include <g3log/g3log.hpp>
 
 #include <ProcessorNode/Package.h>
 #include <ProcessorNode/DataItem.h>
+#include <ProcessorNode/UuidGenerator.h>
 
 
 namespace OHARBase {
@@ -26,18 +23,18 @@ namespace OHARBase {
    const std::string Package::acknowledgementStr = "acknowledgement";
    const std::string Package::emptyString = "";
    
-   /** Default constructor for Package. Generates a random uuid for the Package. */
+   /** Default constructor for Package. Generates a uuid for the Package with the UuidGenerator. */
    Package::Package()
-   : uid(boost::uuids::random_generator()()), type(Package::Type::NoType), payload("")
+   : uid(UuidGenerator::generate()), type(Package::Type::NoType), stream(0), sequence(0), base(0)
    {
    }
    
-   /** Copy constructor for Package. Copies the passed object.
+   /** Copy constructor for Package. Copies the passed object, sharing the payload with it.
     @param p The package to copy from. */
    Package::Package(const Package & p)
-   : uid(p.uid), type(p.type), payload(""), originAddress(p.originAddress), destinationAddress(p.destinationAddress)
+   : uid(p.uid), type(p.type), payload(p.payload), originAddress(p.originAddress), destinationAddress(p.destinationAddress),
+     stream(p.stream), sequence(p.sequence), base(p.base)
    {
-      setPayloadVariant(p.payload);
    }
    
    /** Move constructor for Package. Moves data from
@@ -45,7 +42,8 @@ namespace OHARBase {
     */
    Package::Package(Package && p)
    :  uid(std::move(p.uid)), type(std::move(p.type)),
-      originAddress(std::move(p.originAddress)), destinationAddress(std::move(p.destinationAddress))
+      originAddress(std::move(p.originAddress)), destinationAddress(std::move(p.destinationAddress)),
+      stream(p.stream), sequence(p.sequence), base(p.base)
    {
       payload = std::move(p.payload);
    }
@@ -53,15 +51,15 @@ namespace OHARBase {
    /** A constructor giving an uuid for the otherwise empty package.
     @param id The uuid for the package. */
    Package::Package(const boost::uuids::uuid & id)
-   : uid(id), type(Package::Type::NoType), payload("")
+   : uid(id), type(Package::Type::NoType), stream(0), sequence(0), base(0)
    {
    }
    
-   /** A constructor giving type and data for the package. Uuid is generated.
+   /** A constructor giving type and data for the package. Uuid is generated with the UuidGenerator.
     @param ptype The type for the package.
     @param d The data contents of the package. */
    Package::Package(Type ptype, const std::string & d)
-   : uid(boost::uuids::random_generator()()), type(ptype), payload(d)
+   : uid(UuidGenerator::generate()), type(ptype), payload(std::make_shared<const std::string>(d)), stream(0), sequence(0), base(0)
    {
    }
    
@@ -70,7 +68,7 @@ namespace OHARBase {
     @param ptype The type of the data (control or data package).
     @param d The data contents of the package. */
    Package::Package(const boost::uuids::uuid & id, Type ptype, const std::string & d)
-   : uid(id), type(ptype), payload(d)
+   : uid(id), type(ptype), payload(std::make_shared<const std::string>(d)), stream(0), sequence(0), base(0)
    {
    }
    
@@ -146,11 +144,13 @@ namespace OHARBase {
    }
    
    /** Get the unparsed data contents for the Package.
-    @return the data of the package, empty string if parsed to Dataitem. */
+    @return the data of the package, empty string if parsed to Dataitem or held as a JSON value.
+    @throws nlohmann::json::parse_error if the payload is raw JSON text which is not valid JSON. */
    const std::string & Package::getPayloadString() const {
-      auto item = std::get_if<std::string>(&payload);
-      if (item) {
-         return *item;
+      parseRawPayload();
+      auto item = std::get_if<Buffer>(&payload);
+      if (item && *item) {
+         return **item;
       }
       return emptyString;
    }
@@ -158,7 +158,13 @@ namespace OHARBase {
    /** Sets the unparsed data for the Package.
     @param d The data for this Package. */
    void Package::setPayload(const std::string & d) {
-      payload = d;
+      payload = std::make_shared<const std::string>(d);
+   }
+   
+   /** Sets the unparsed data for the Package, moving it to the package.
+    @param d The data for this Package. */
+   void Package::setPayload(std::string && d) {
+      payload = std::make_shared<const std::string>(std::move(d));
    }
    
    /** Use for getting the parsed, structured DataItem of
@@ -166,7 +172,7 @@ namespace OHARBase {
     been parsed from the data member variable.
     @return The pointer to the data item object. */
    const DataItem * Package::getPayloadObject() const {
-      auto item = std::get_if<std::unique_ptr<DataItem>>(&payload);
+      auto item = std::get_if<std::shared_ptr<DataItem>>(&payload);
       if (item) {
          return item->get();
       }
@@ -176,10 +182,14 @@ namespace OHARBase {
    /** Use for getting the modifiable pointer to the parsed,
     structured DataItem of the Package. May be null if there
     is no data or it has not been parsed from the data member variable.
+    A data item shared with a copy of the package is cloned first.
     @return The pointer to the data item object. */
    DataItem * Package::getPayloadObject() {
-      auto item = std::get_if<std::unique_ptr<DataItem>>(&payload);
+      auto item = std::get_if<std::shared_ptr<DataItem>>(&payload);
       if (item) {
+         if (*item && item->use_count() > 1) {
+            *item = (*item)->clone();
+         }
          return item->get();
       }
       return nullptr;
@@ -189,7 +199,103 @@ namespace OHARBase {
     @param item The new dataitem for this package. DataItem is copied, so caller must handle
     the parameter object lifetime. */
    void Package::setPayload(std::unique_ptr<DataItem> item) {
-      payload = std::move(item);
+      payload = std::shared_ptr<DataItem>(std::move(item));
+   }
+   
+   /** Use for getting the JSON value of the payload, if the payload is embedded in the package JSON
+    as a JSON value instead of a string.
+    @return The pointer to the JSON value, nullptr if the payload is not a JSON value. */
+   const nlohmann::json * Package::getPayloadJson() const {
+      parseRawPayload();
+      auto value = std::get_if<JsonValue>(&payload);
+      if (value) {
+         return value->value.get();
+      }
+      return nullptr;
+   }
+   
+   /** Use for getting the modifiable JSON value of the payload. A value shared with a copy of the
+    package is copied first.
+    @return The pointer to the JSON value, nullptr if the payload is not a JSON value. */
+   nlohmann::json * Package::getPayloadJson() {
+      parseRawPayload();
+      auto value = std::get_if<JsonValue>(&payload);
+      if (value) {
+         if (value->value.use_count() > 1) {
+            value->value = std::make_shared<nlohmann::json>(*value->value);
+         }
+         return value->value.get();
+      }
+      return nullptr;
+   }
+   
+   /** Sets a JSON value as the payload. The value is embedded in the package JSON as it is, so it is
+    not escaped into a string when sent, and the receiving Node gives it to the handlers already parsed.
+    @param value The payload.
+    @param size The size of the JSON text the value was parsed from, counted as the size of the payload
+    in the queues. Zero if not known. */
+   void Package::setPayloadJson(const nlohmann::json & value, std::size_t size) {
+      payload = JsonValue{std::make_shared<nlohmann::json>(value), size};
+   }
+   
+   /** Sets a JSON value as the payload, moving it to the package.
+    @param value The payload.
+    @param size The size of the JSON text the value was parsed from, zero if not known. */
+   void Package::setPayloadJson(nlohmann::json && value, std::size_t size) {
+      payload = JsonValue{std::make_shared<nlohmann::json>(std::move(value)), size};
+   }
+   
+   /** Use for getting the payload as the JSON text it was received in, when the package was received
+    in the cut-through mode and the payload has not been parsed. The payload is parsed when it is
+    asked with getPayloadString() or getPayloadJson().
+    @return The pointer to the JSON text of the payload, nullptr if the payload is not raw JSON text. */
+   const std::string * Package::getPayloadRawJson() const {
+      auto raw = std::get_if<RawJson>(&payload);
+      if (raw) {
+         return raw->text.get();
+      }
+      return nullptr;
+   }
+   
+   /** Sets the payload as JSON text, parsed only if the payload is asked for. Sent as it is, so the
+    text must be a valid JSON value: a string in quotes, an object, an array, a number or a literal.
+    @param text The JSON text of the payload. */
+   void Package::setPayloadRawJson(std::string && text) {
+      payload = RawJson{std::make_shared<const std::string>(std::move(text))};
+   }
+   
+   /** Gets the size of the payload string or the raw JSON text of the payload, without parsing it.
+    For a JSON value payload, the size of the JSON text it was parsed from.
+    @return The size in bytes, 0 for a parsed DataItem or a JSON value payload of unknown size. */
+   std::size_t Package::payloadSize() const {
+      auto item = std::get_if<Buffer>(&payload);
+      if (item) {
+         return *item ? (*item)->length() : 0;
+      }
+      auto raw = std::get_if<RawJson>(&payload);
+      if (raw) {
+         return raw->text->length();
+      }
+      auto value = std::get_if<JsonValue>(&payload);
+      if (value) {
+         return value->size;
+      }
+      return 0;
+   }
+   
+   /** Parses a raw JSON text payload to a string, if it is a JSON string, or to a JSON value.
+    Only this package gets the parsed payload, the copies sharing the text keep it as it is.
+    @throws nlohmann::json::parse_error if the text is not valid JSON. */
+   void Package::parseRawPayload() const {
+      auto raw = std::get_if<RawJson>(&payload);
+      if (raw) {
+         nlohmann::json value = nlohmann::json::parse(*raw->text);
+         if (value.is_string()) {
+            payload = std::make_shared<const std::string>(std::move(value.get_ref<std::string &>()));
+         } else {
+            payload = JsonValue{std::make_shared<nlohmann::json>(std::move(value)), raw->text->length()};
+         }
+      }
    }
    
    /** Use to query if package is empty. Package is empty if it has no type and dataItem is nullptr.
@@ -198,78 +304,181 @@ namespace OHARBase {
       return (type == NoType);
    }
    
+   /** Parses an address in host:port or port format to an endpoint. If the host is not given,
+    the address of the endpoint is left unspecified.
+    @param address The address to parse.
+    @param endpoint The endpoint to set, cleared if the address cannot be parsed.
+    */
+   static void parseAddress(const std::string & address, boost::asio::ip::udp::endpoint & endpoint) {
+      endpoint = boost::asio::ip::udp::endpoint();
+      if (address.empty()) {
+         return;
+      }
+      try {
+         std::size_t colon = address.find(':');
+         if (colon == std::string::npos) {
+            endpoint.port(static_cast<unsigned short>(std::stoi(address)));
+         } else {
+            boost::system::error_code ec;
+            boost::asio::ip::address host = boost::asio::ip::address::from_string(address.substr(0, colon), ec);
+            if (!ec) {
+               endpoint = boost::asio::ip::udp::endpoint(host, static_cast<unsigned short>(std::stoi(address.substr(colon + 1))));
+            }
+         }
+      } catch (const std::exception &) {
+         LOG(WARNING) << "Invalid package address " << address;
+      }
+   }
+
+   /** Formats an endpoint as host:port, or port only if the address is unspecified.
+    @param endpoint The endpoint to format.
+    @return The address as a string, empty if the port is zero.
+    */
+   static std::string formatAddress(const boost::asio::ip::udp::endpoint & endpoint) {
+      if (endpoint.port() == 0) {
+         return "";
+      }
+      if (endpoint.address().is_unspecified()) {
+         return std::to_string(endpoint.port());
+      }
+      return endpoint.address().to_string() + ":" + std::to_string(endpoint.port());
+   }
+
    /** Sets the address where the package came from. Empty, if package did not come from outside the node.
-    @param o Address of the package origin. */
+    The address is parsed once here; prefer the endpoint version of the method when the address is already parsed.
+    @param o Address of the package origin, as host:port or port. */
    void Package::setOrigin(const std::string & o) {
+      parseAddress(o, originAddress);
+   }
+
+   /** Sets the address where the package came from.
+    @param o Address of the package origin. The address may be unspecified if only the port is known. */
+   void Package::setOrigin(const boost::asio::ip::udp::endpoint & o) {
       originAddress = o;
    }
 
    /** Gets the address where the package came from. Empty, if package did not come from outside the node.
-    @return Address of the package origin. */
-   const std::string & Package::origin() const {
+    @return Address of the package origin, as host:port or port. */
+   std::string Package::origin() const {
+      return formatAddress(originAddress);
+   }
+
+   /** Gets the address where the package came from, without formatting it to a string.
+    @return Address of the package origin. Port is zero if the origin is not known. */
+   const boost::asio::ip::udp::endpoint & Package::originEndpoint() const {
       return originAddress;
    }
 
+   /** Gets the listening port of the origin of the package.
+    @return The port, or zero if not known. */
+   unsigned short Package::originPort() const {
+      return originAddress.port();
+   }
+
    /** Use to query if the package has an origin address or not.
     @return Returns true if the package has an origin address. */
    bool Package::hasOrigin() const {
-      return originAddress.length() > 0;
+      return originAddress.port() != 0;
    }
 
    /** Gets the listening port of the origin of the package.
-    If the address is form host:port, returns the port. Otherwise the address must be the port number only.
     If there is no address, empty string is returned to indicate no address/port is known.
     @return The port number or an empty string.
     */
    std::string Package::getPackageOriginsListeningPort() const {
-      if (originAddress.length() > 0) {
-         std::vector<std::string> addressElements;
-         boost::split(addressElements, originAddress, boost::is_any_of(":"));
-         if (addressElements.size() == 2) {
-            return addressElements[1];
-         } else {
-            return originAddress;
-         }
+      if (originAddress.port() != 0) {
+         return std::to_string(originAddress.port());
       }
       return "";
    }
 
    /** Get the host part of the package sender's address. If not there, returns an empty string.
-    If the address is form host:port, returns the port. Otherwise the address must be the port number only.
     If there is no address, empty string is returned to indicate no host is known.
     @return The host address of the sender.
     */
    std::string Package::getPackageOriginsHost() const {
-      if (originAddress.length() > 0) {
-         std::vector<std::string> addressElements;
-         boost::split(addressElements, originAddress, boost::is_any_of(":"));
-         if (addressElements.size() == 2) {
-            return addressElements[0];
-         }
+      if (originAddress.port() != 0 && !originAddress.address().is_unspecified()) {
+         return originAddress.address().to_string();
       }
       return "";
    }
 
+   /** Sets the package's destination address. The address is parsed once here; prefer the endpoint
+    version of the method when the address is already parsed.
+    @param d The destination of the package, as host:port. */
+   void Package::setDestination(const std::string & d) {
+      parseAddress(d, destinationAddress);
+   }
+
    /** Sets the package's destination address.
     @param d The destination of the package. */
-   void Package::setDestination(const std::string & d) {
+   void Package::setDestination(const boost::asio::ip::udp::endpoint & d) {
       destinationAddress = d;
    }
 
    /** Gets the package's destination address.
-    @return The destination of the package. */
-   const std::string & Package::destination() const {
+    @return The destination of the package, as host:port. */
+   std::string Package::destination() const {
+      return formatAddress(destinationAddress);
+   }
+
+   /** Gets the package's destination address, without formatting it to a string.
+    @return The destination of the package. Port is zero if the package has no destination. */
+   const boost::asio::ip::udp::endpoint & Package::destinationEndpoint() const {
       return destinationAddress;
    }
 
    /** Use to query if the package has a package specific destination address or not.
     @return Returns true if the package has a destination address. */
    bool Package::hasDestination() const {
-      return destinationAddress.length() > 0;
+      return destinationAddress.port() != 0 && !destinationAddress.address().is_unspecified();
+   }
+
+   /** Sets the sequence number of the package. Sequence numbers are given by the NetworkWriter to the
+    packages sent with acknowledgements, so that the receiving node can acknowledge many packages at once.
+    @param streamId The stream of packages from this node to the destination.
+    @param number The sequence number of the package in the stream. Zero clears the sequence number.
+    The base of the sequence is cleared; set it with setSequenceBase(). */
+   void Package::setSequence(std::uint32_t streamId, std::uint64_t number) {
+      stream = number != 0 ? streamId : 0;
+      sequence = number;
+      base = 0;
+   }
+
+   /** Gets the stream the sequence number of the package belongs to.
+    @return The stream id, zero if the package has no sequence number. */
+   std::uint32_t Package::getStream() const {
+      return stream;
+   }
+
+   /** Gets the sequence number of the package.
+    @return The sequence number, zero if the package has none. */
+   std::uint64_t Package::getSequence() const {
+      return sequence;
+   }
+
+   /** Use to query if the package has a sequence number.
+    @return Returns true if the package has a sequence number. */
+   bool Package::hasSequence() const {
+      return sequence != 0;
+   }
+
+   /** Sets the base of the sequence: the lowest sequence number in the stream the sender is still waiting
+    the ack for. The receiver takes the packages below it as done, since the sender has had them acknowledged
+    or has given them up, and does not wait for the missing ones among them.
+    @param number The base, at most the sequence number of the package. Zero if not known. */
+   void Package::setSequenceBase(std::uint64_t number) {
+      base = number;
+   }
+
+   /** Gets the base of the sequence, see setSequenceBase().
+    @return The lowest sequence number not yet acknowledged when the package was sent, zero if not known. */
+   std::uint64_t Package::getSequenceBase() const {
+      return base;
    }
 
    /**
-    Assignment operator for Package.
+    Assignment operator for Package. The payload is shared with the package copied.
     @param p The package to copy.
     @return The package with assigned new values.
     */
@@ -277,27 +486,16 @@ namespace OHARBase {
       if (this != &p) {
          uid = p.uid;
          type = p.type;
-         setPayloadVariant(p.payload);
+         payload = p.payload;
          originAddress = p.originAddress;
          destinationAddress = p.destinationAddress;
+         stream = p.stream;
+         sequence = p.sequence;
+         base = p.base;
       }
       return *this;
    }
    
-   /**
-    Sets the value for the payload, depending on the type of the parameter.
-    @param x The payload to set.
-    */
-   void Package::setPayloadVariant(const std::variant<std::string,std::unique_ptr<DataItem>> & x) {
-      auto item = std::get_if<std::unique_ptr<DataItem>>(&x);
-      if (item) {
-         setPayload(item->get()->clone());
-      } else {
-         setPayload(std::get<std::string>(x));
-      }
-
-   }
-   
    /**
     Move assignment operator for Package, moving values from the parameter to this object..
     @param p The package to move.
@@ -310,6 +508,9 @@ namespace OHARBase {
          payload = std::move(p.payload);
          originAddress = std::move(p.originAddress);
          destinationAddress = std::move(p.destinationAddress);
+         stream = p.stream;
+         sequence = p.sequence;
+         base = p.base;
       }
       return *this;
    }
@@ -323,26 +524,94 @@ namespace OHARBase {
       return (uid == pkg.uid);
    }
       
+   /**
+    Puts the fields of the Package other than the payload to a JSON object.
+    @param j The JSON object to fill with the fields.
+    @param package The package to externalize.
+    */
+   static void fieldsToJson(nlohmann::json & j, const Package & package) {
+      j = nlohmann::json{{"package", to_string(package.getUuid())}};
+      j["type"] = package.getTypeAsString();
+      if (package.originPort() != 0) {
+         j["sender-listening-port"] = std::to_string(package.originPort());
+      }
+      if (package.hasSequence()) {
+         j["stream"] = package.getStream();
+         j["sequence"] = package.getSequence();
+         if (package.getSequenceBase() != 0) {
+            j["base"] = package.getSequenceBase();
+         }
+      }
+   }
+   
    /**
     Externalizes the Package to a JSON object. Note that (at least currently) the originAddress and
     destinationAddress are not externalized to JSON. Addresses are used only by package handlers,
-    NetworkReader and NetworkWriter to route packages.
+    NetworkReader and NetworkWriter to route packages. A JSON value payload is embedded as such,
+    other payloads as strings.
     @param j The JSON object fill with package contents.
     @param package The package to exernalize.
     */
    void to_json(nlohmann::json & j, const Package & package) {
-      j = nlohmann::json{{"package", to_string(package.getUuid())}};
-      j["type"] = package.getTypeAsString();
-      j["payload"] = package.getPayloadString();
-      if (package.getPackageOriginsListeningPort().length() > 0) {
-         j["sender-listening-port"] = package.getPackageOriginsListeningPort();
+      fieldsToJson(j, package);
+      const nlohmann::json * payload = package.getPayloadJson();
+      if (payload) {
+         j["payload"] = *payload;
+      } else {
+         j["payload"] = package.getPayloadString();
       }
    }
    
+   /**
+    Serializes the Package to JSON text, as to_json() and dumping the JSON object would. A JSON value payload
+    is dumped after the other fields as it is, without copying it into the JSON object of the package first,
+    and a raw JSON text payload is copied as it is, without parsing it.
+    @param package The package to serialize.
+    @param serialized The JSON text replaces the contents of this string.
+    */
+   void dumpJson(const Package & package, std::string & serialized) {
+      const std::string * raw = package.getPayloadRawJson();
+      const nlohmann::json * payload = raw ? nullptr : package.getPayloadJson();
+      if (!raw && !payload) {
+         nlohmann::json j = package;
+         serialized = j.dump();
+         return;
+      }
+      // The fields need no escaping, so they are written as they are.
+      serialized.assign("{\"package\":\"");
+      serialized.append(to_string(package.getUuid()));
+      serialized.append("\",\"type\":\"");
+      serialized.append(package.getTypeAsString());
+      serialized.push_back('"');
+      if (package.originPort() != 0) {
+         serialized.append(",\"sender-listening-port\":\"");
+         serialized.append(std::to_string(package.originPort()));
+         serialized.push_back('"');
+      }
+      if (package.hasSequence()) {
+         serialized.append(",\"stream\":");
+         serialized.append(std::to_string(package.getStream()));
+         serialized.append(",\"sequence\":");
+         serialized.append(std::to_string(package.getSequence()));
+         if (package.getSequenceBase() != 0) {
+            serialized.append(",\"base\":");
+            serialized.append(std::to_string(package.getSequenceBase()));
+         }
+      }
+      serialized.append(",\"payload\":");
+      if (raw) {
+         serialized.append(*raw);
+      } else {
+         serialized.append(payload->dump());
+      }
+      serialized.push_back('}');
+   }
+   
    /**
     Internalizes the package contents from a JSON structure. Note that (at least currently) the originAddress and
     destinationAddress are not internalized from JSON. Addresses are used only by package handlers,
-    NetworkReader and NetworkWriter to route packages.
+    NetworkReader and NetworkWriter to route packages. A payload which is not a string, but
+    a JSON object, array or other value embedded in the package, is kept as a JSON value.
     @param j The JSON object containing Package data elements.
     @param package The package to initialize from the JSON structure.
     */
@@ -354,12 +623,23 @@ namespace OHARBase {
       if (j.find("type") != j.end()) {
          package.setTypeFromString(j["type"].get<std::string>());
       }
-      if (j.find("payload") != j.end()) {
-         package.setPayload(j["payload"].get<std::string>());
+      auto payload = j.find("payload");
+      if (payload != j.end()) {
+         if (payload->is_string()) {
+            package.setPayload(payload->get<std::string>());
+         } else {
+            package.setPayloadJson(*payload);
+         }
       }
       if (j.find("sender-listening-port") != j.end()) {
          package.setOrigin(j["sender-listening-port"].get<std::string>());
       }
+      if (j.find("sequence") != j.end() && j.find("stream") != j.end()) {
+         package.setSequence(j["stream"].get<std::uint32_t>(), j["sequence"].get<std::uint64_t>());
+         if (j.find("base") != j.end()) {
+            package.setSequenceBase(j["base"].get<std::uint64_t>());
+         }
+      }
    }
    
    
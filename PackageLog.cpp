@@ -0,0 +1,480 @@
+//
+//  PackageLog.cpp
+//  ProcessorNode
+//
+
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <g3log/g3log.hpp>
+
+#include <nlohmann/json.hpp>
+
+#include <ProcessorNode/PackageLog.h>
+
+namespace OHARBase {
+
+   const std::string PackageLog::TAG{"PackageLog "};
+
+#if defined(__linux__) || defined(__APPLE__)
+
+   /** Record kind of a package. */
+   static const std::uint32_t PACKAGE_RECORD{0x504B4731};
+   /** Record kind of the completion of a package. */
+   static const std::uint32_t COMPLETE_RECORD{0x434D5031};
+   /** Records start at multiples of this. */
+   static const std::size_t RECORD_ALIGNMENT{8};
+   /** Size of the record header. */
+   static const std::size_t HEADER_SIZE{24};
+   /** File name extension of the segment files. */
+   static const std::string SEGMENT_EXTENSION{".seg"};
+
+   /** The header of a record in a segment. A segment ends at a header with kind 0. */
+   struct PackageLog::RecordHeader {
+      /** PACKAGE_RECORD or COMPLETE_RECORD. */
+      std::uint32_t kind;
+      /** Length of the data following the header. */
+      std::uint32_t length;
+      /** The id of the package. */
+      std::uint64_t id;
+      /** Checksum of the kind, length, id and data. */
+      std::uint32_t checksum;
+      /** Unused, zero. */
+      std::uint32_t reserved;
+   };
+
+   /**
+    Calculates the checksum of a record (32 bit FNV-1a).
+    @param kind The record kind.
+    @param length Length of the data.
+    @param id The package id.
+    @param data The data.
+    @return The checksum.
+    */
+   static std::uint32_t checksumOf(std::uint32_t kind, std::uint32_t length, std::uint64_t id, const char * data) {
+      std::uint32_t hash = 2166136261u;
+      auto add = [&hash](const void * bytes, std::size_t count) {
+         const unsigned char * b = static_cast<const unsigned char *>(bytes);
+         for (std::size_t i = 0; i < count; i++) {
+            hash = (hash ^ b[i]) * 16777619u;
+         }
+      };
+      add(&kind, sizeof(kind));
+      add(&length, sizeof(length));
+      add(&id, sizeof(id));
+      add(data, length);
+      return hash;
+   }
+
+   /**
+    Gets the size of a record in a segment, including the header and the padding.
+    @param length Length of the record data.
+    @return The size in bytes.
+    */
+   static std::size_t recordSize(std::size_t length) {
+      const std::size_t size = HEADER_SIZE + length;
+      return (size + RECORD_ALIGNMENT - 1) / RECORD_ALIGNMENT * RECORD_ALIGNMENT;
+   }
+
+   /**
+    Opens the log in a directory, creating the directory if it does not exist. The packages not completed
+    in the segments found in the directory are available with pendingIds().
+    @param dir The directory of the segment files.
+    @param size The size of a new segment file.
+    @throws std::runtime_error if the directory or the segments cannot be opened.
+    */
+   PackageLog::PackageLog(const std::string & dir, std::size_t size)
+   : directory(dir), segmentSize(size), nextId(1), appending(false)
+   {
+      static_assert(sizeof(RecordHeader) == HEADER_SIZE, "Record header size must match");
+      if (::mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+         throw std::runtime_error("Cannot create the log directory " + directory + ": " + std::strerror(errno));
+      }
+      scan();
+      LOG(INFO) << TAG << "Opened " << directory << " with " << segments.size() << " segments and " << records.size() << " packages not completed.";
+   }
+
+   /**
+    Closes the log, flushing the records to the disk. The segment files stay for the next time.
+    */
+   PackageLog::~PackageLog() {
+      sync();
+      for (auto & item : segments) {
+         closeSegment(item.second, false);
+      }
+   }
+
+   /**
+    Appends a package to the log.
+    @param package The package.
+    @return The id of the package, given to complete() when the package has been delivered.
+    @throws std::runtime_error if a new segment file cannot be created.
+    */
+   std::uint64_t PackageLog::append(const Package & package) {
+      std::string data;
+      dumpJson(package, data);
+      Segment & segment = segmentFor(recordSize(data.length()));
+      const std::uint64_t id = nextId++;
+      records[id] = Location{segments.rbegin()->first, segment.used};
+      segment.pending++;
+      writeRecord(segment, PACKAGE_RECORD, id, data);
+      return id;
+   }
+
+   /**
+    Reads a package not yet completed from the log.
+    @param id The id of the package.
+    @param package The package read.
+    @return Returns false if the package is not in the log or cannot be parsed.
+    */
+   bool PackageLog::read(std::uint64_t id, Package & package) const {
+      auto found = records.find(id);
+      if (found == records.end()) {
+         return false;
+      }
+      const Segment & segment = segments.at(found->second.segment);
+      const RecordHeader * header = reinterpret_cast<const RecordHeader *>(segment.data + found->second.offset);
+      const char * data = segment.data + found->second.offset + sizeof(RecordHeader);
+      try {
+         package = nlohmann::json::parse(data, data + header->length).get<Package>();
+         return true;
+      } catch (const std::exception & e) {
+         LOG(WARNING) << TAG << "Package " << id << " in the log cannot be parsed: " << e.what();
+      }
+      return false;
+   }
+
+   /**
+    Completes a package, so that it is not sent again when the log is opened next time.
+    Segments with all their packages completed are deleted.
+    @param id The id of the package.
+    */
+   void PackageLog::complete(std::uint64_t id) {
+      auto found = records.find(id);
+      if (found == records.end()) {
+         return;
+      }
+      Segment & segment = segments.at(found->second.segment);
+      records.erase(found);
+      segment.pending--;
+      try {
+         writeRecord(segmentFor(recordSize(0)), COMPLETE_RECORD, id, std::string());
+      } catch (const std::exception & e) {
+         // The package is sent again after a restart, which is allowed.
+         LOG(WARNING) << TAG << "Cannot complete package " << id << ": " << e.what();
+      }
+      removeCompletedSegments();
+   }
+
+   /**
+    Flushes the records written since the previous call to the disk.
+    */
+   void PackageLog::sync() {
+      std::vector<Range> ranges;
+      takeUnsynced(ranges);
+      sync(ranges);
+   }
+
+   /**
+    Takes the records written since the previous call, to be flushed to the disk with sync(ranges). The records
+    are counted as flushed, so the caller must flush the ranges before the segments can be closed, that is
+    before completing packages. Records written after this call are flushed by the next one.
+    @param ranges The ranges to flush are appended to this vector.
+    */
+   void PackageLog::takeUnsynced(std::vector<Range> & ranges) {
+      static const std::size_t pageSize = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+      for (auto & item : segments) {
+         Segment & segment = item.second;
+         if (segment.synced < segment.used) {
+            const std::size_t start = segment.synced / pageSize * pageSize;
+            ranges.push_back(Range{segment.data + start, segment.used - start, segment.path});
+            segment.synced = segment.used;
+         }
+      }
+   }
+
+   /**
+    Flushes records to the disk. Needs no lock, since records are only appended after the ranges.
+    @param ranges The ranges taken with takeUnsynced().
+    */
+   void PackageLog::sync(const std::vector<Range> & ranges) {
+      for (const Range & range : ranges) {
+         if (::msync(range.data, range.length, MS_SYNC) != 0) {
+            LOG(WARNING) << TAG << "Cannot sync " << range.path << ": " << std::strerror(errno);
+         }
+      }
+   }
+
+   /**
+    Gets the ids of the packages not yet completed, in the order they were appended.
+    @param ids The ids are appended to this vector.
+    */
+   void PackageLog::pendingIds(std::vector<std::uint64_t> & ids) const {
+      const std::size_t first = ids.size();
+      for (const auto & item : records) {
+         ids.push_back(item.first);
+      }
+      std::sort(ids.begin() + static_cast<std::ptrdiff_t>(first), ids.end());
+   }
+
+   /**
+    Gets the number of packages not yet completed.
+    @return The number of packages.
+    */
+   std::size_t PackageLog::pendingCount() const {
+      return records.size();
+   }
+
+   /**
+    Gets the number of segment files.
+    @return The number of segments.
+    */
+   std::size_t PackageLog::segmentCount() const {
+      return segments.size();
+   }
+
+   /**
+    Opens the segment files in the directory and finds the packages not completed.
+    @throws std::runtime_error if the directory cannot be read.
+    */
+   void PackageLog::scan() {
+      DIR * dir = ::opendir(directory.c_str());
+      if (!dir) {
+         throw std::runtime_error("Cannot read the log directory " + directory + ": " + std::strerror(errno));
+      }
+      std::vector<std::string> names;
+      while (struct dirent * entry = ::readdir(dir)) {
+         std::string name(entry->d_name);
+         if (name.length() > SEGMENT_EXTENSION.length() && name.compare(name.length() - SEGMENT_EXTENSION.length(), SEGMENT_EXTENSION.length(), SEGMENT_EXTENSION) == 0) {
+            names.push_back(name);
+         }
+      }
+      ::closedir(dir);
+      // Names are zero padded ids, so they sort in the order of the ids.
+      std::sort(names.begin(), names.end());
+      for (const std::string & name : names) {
+         const std::uint64_t first = std::stoull(name.substr(0, name.length() - SEGMENT_EXTENSION.length()));
+         Segment segment{directory + "/" + name, -1, nullptr, 0, 0, 0, 0};
+         segment.file = ::open(segment.path.c_str(), O_RDWR);
+         struct stat status;
+         if (segment.file < 0 || ::fstat(segment.file, &status) != 0 || status.st_size == 0) {
+            LOG(WARNING) << TAG << "Cannot open the segment " << segment.path << ", skipped.";
+            if (segment.file >= 0) {
+               ::close(segment.file);
+            }
+            continue;
+         }
+         segment.size = static_cast<std::size_t>(status.st_size);
+         void * mapped = ::mmap(nullptr, segment.size, PROT_READ | PROT_WRITE, MAP_SHARED, segment.file, 0);
+         if (mapped == MAP_FAILED) {
+            ::close(segment.file);
+            throw std::runtime_error("Cannot map the segment " + segment.path + ": " + std::strerror(errno));
+         }
+         segment.data = static_cast<char *>(mapped);
+         scanSegment(first, segments.emplace(first, segment).first->second);
+      }
+      removeCompletedSegments();
+   }
+
+   /**
+    Reads the records of a segment, adding its packages to the packages not completed and removing
+    the packages completed in it.
+    @param first The id of the first package of the segment.
+    @param segment The segment.
+    */
+   void PackageLog::scanSegment(std::uint64_t first, Segment & segment) {
+      std::size_t offset = 0;
+      while (offset + sizeof(RecordHeader) <= segment.size) {
+         const RecordHeader * header = reinterpret_cast<const RecordHeader *>(segment.data + offset);
+         if (header->kind == 0) {
+            break;
+         }
+         const char * data = segment.data + offset + sizeof(RecordHeader);
+         if ((header->kind != PACKAGE_RECORD && header->kind != COMPLETE_RECORD)
+             || header->length > segment.size - offset - sizeof(RecordHeader)
+             || header->checksum != checksumOf(header->kind, header->length, header->id, data)) {
+            LOG(WARNING) << TAG << "Invalid record at " << offset << " in " << segment.path << ", the rest of the segment is ignored.";
+            break;
+         }
+         if (header->kind == PACKAGE_RECORD) {
+            records[header->id] = Location{first, offset};
+            segment.pending++;
+            nextId = std::max(nextId, header->id + 1);
+         } else {
+            auto found = records.find(header->id);
+            if (found != records.end()) {
+               segments.at(found->second.segment).pending--;
+               records.erase(found);
+            }
+         }
+         offset += recordSize(header->length);
+      }
+      segment.used = offset;
+      segment.synced = offset;
+   }
+
+   /**
+    Gets the segment to append a record to, starting a new segment if the record does not fit into the last one.
+    @param size The size of the record.
+    @return The segment.
+    @throws std::runtime_error if a new segment file cannot be created.
+    */
+   PackageLog::Segment & PackageLog::segmentFor(std::size_t size) {
+      if (appending && !segments.empty()) {
+         Segment & last = segments.rbegin()->second;
+         // Space is left for the header ending the segment.
+         if (last.used + size + sizeof(RecordHeader) <= last.size) {
+            return last;
+         }
+      }
+      // Segments are named after the id of the next package, but a segment of completion records only
+      // leaves that id unused, so the name must also come after the last segment.
+      const std::uint64_t first = segments.empty() ? nextId : std::max(nextId, segments.rbegin()->first + 1);
+      char name[32];
+      std::snprintf(name, sizeof(name), "%020llu", static_cast<unsigned long long>(first));
+      Segment segment{directory + "/" + name + SEGMENT_EXTENSION, -1, nullptr, std::max(segmentSize, size + sizeof(RecordHeader)), 0, 0, 0};
+      segment.file = ::open(segment.path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+      if (segment.file < 0) {
+         throw std::runtime_error("Cannot create the segment " + segment.path + ": " + std::strerror(errno));
+      }
+      if (::ftruncate(segment.file, static_cast<off_t>(segment.size)) != 0) {
+         const std::string error = std::strerror(errno);
+         ::close(segment.file);
+         ::unlink(segment.path.c_str());
+         throw std::runtime_error("Cannot allocate the segment " + segment.path + ": " + error);
+      }
+      void * mapped = ::mmap(nullptr, segment.size, PROT_READ | PROT_WRITE, MAP_SHARED, segment.file, 0);
+      if (mapped == MAP_FAILED) {
+         const std::string error = std::strerror(errno);
+         ::close(segment.file);
+         ::unlink(segment.path.c_str());
+         throw std::runtime_error("Cannot map the segment " + segment.path + ": " + error);
+      }
+      segment.data = static_cast<char *>(mapped);
+      syncDirectory();
+      appending = true;
+      LOG(INFO) << TAG << "New segment " << segment.path;
+      return segments.emplace(first, segment).first->second;
+   }
+
+   /**
+    Writes a record to the end of a segment.
+    @param segment The segment, with space for the record.
+    @param kind The record kind.
+    @param id The package id.
+    @param data The record data.
+    */
+   void PackageLog::writeRecord(Segment & segment, std::uint32_t kind, std::uint64_t id, const std::string & data) {
+      RecordHeader header{kind, static_cast<std::uint32_t>(data.length()), id, checksumOf(kind, static_cast<std::uint32_t>(data.length()), id, data.data()), 0};
+      char * record = segment.data + segment.used;
+      std::memcpy(record + sizeof(RecordHeader), data.data(), data.length());
+      std::memcpy(record, &header, sizeof(RecordHeader));
+      segment.used += recordSize(data.length());
+   }
+
+   /**
+    Deletes the oldest segments while all their packages have been completed. The segment appended to
+    is not deleted. Segments are deleted only from the oldest, so the completion records of the packages
+    in a segment still in the log are never deleted.
+    */
+   void PackageLog::removeCompletedSegments() {
+      while (!segments.empty()) {
+         auto oldest = segments.begin();
+         const bool last = (std::next(oldest) == segments.end());
+         if (oldest->second.pending > 0 || (last && appending)) {
+            break;
+         }
+         LOG(INFO) << TAG << "All packages in " << oldest->second.path << " completed, deleting it.";
+         closeSegment(oldest->second, true);
+         segments.erase(oldest);
+      }
+   }
+
+   /**
+    Unmaps and closes a segment file.
+    @param segment The segment.
+    @param remove If true, the file is deleted.
+    */
+   void PackageLog::closeSegment(Segment & segment, bool remove) {
+      if (segment.data) {
+         ::munmap(segment.data, segment.size);
+         segment.data = nullptr;
+      }
+      if (segment.file >= 0) {
+         ::close(segment.file);
+         segment.file = -1;
+      }
+      if (remove) {
+         ::unlink(segment.path.c_str());
+      }
+   }
+
+   /**
+    Flushes the directory entries to the disk, so that a new segment file is found after a crash of the host.
+    */
+   void PackageLog::syncDirectory() {
+      int dir = ::open(directory.c_str(), O_RDONLY);
+      if (dir >= 0) {
+         ::fsync(dir);
+         ::close(dir);
+      }
+   }
+
+#else
+
+   struct PackageLog::RecordHeader {
+   };
+
+   PackageLog::PackageLog(const std::string & dir, std::size_t size)
+   : directory(dir), segmentSize(size), nextId(1), appending(false)
+   {
+      throw std::runtime_error("The package log is supported only in Linux and macOS");
+   }
+
+   PackageLog::~PackageLog() {
+   }
+
+   std::uint64_t PackageLog::append(const Package & package) {
+      return 0;
+   }
+
+   bool PackageLog::read(std::uint64_t id, Package & package) const {
+      return false;
+   }
+
+   void PackageLog::complete(std::uint64_t id) {
+   }
+
+   void PackageLog::sync() {
+   }
+
+   void PackageLog::takeUnsynced(std::vector<Range> & ranges) {
+   }
+
+   void PackageLog::sync(const std::vector<Range> & ranges) {
+   }
+
+   void PackageLog::pendingIds(std::vector<std::uint64_t> & ids) const {
+   }
+
+   std::size_t PackageLog::pendingCount() const {
+      return 0;
+   }
+
+   std::size_t PackageLog::segmentCount() const {
+      return 0;
+   }
+
+#endif
+
+} //namespace
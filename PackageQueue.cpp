@@ -0,0 +1,319 @@
+//
+//  PackageQueue.cpp
+//  ProcessorNode
+//
+
+#include <stdexcept>
+
+#include <boost/uuid/uuid_io.hpp>
+
+#include <g3log/g3log.hpp>
+
+#include <ProcessorNode/PackageQueue.h>
+
+namespace OHARBase {
+
+   /**
+    Creates an empty queue with no limits.
+    */
+   PackageQueue::PackageQueue()
+   : count(0), totalBytes(0), nextOrder(0), packageLimit(0), byteLimit(0), overflow(Overflow::Block), droppedCount(0)
+   {
+   }
+
+   /**
+    Adds a package to the end of the lane of its type. The package is added even if the queue
+    is full; call makeRoom() first to apply the overflow policy.
+    @param package The package to add.
+    */
+   void PackageQueue::push(const Package & package) {
+      const std::size_t size = sizeOf(package);
+      lanes[laneOf(package.getType())].push(Entry{package, size, nextOrder++});
+      count++;
+      totalBytes += size;
+   }
+
+   /**
+    Moves a package to the end of the lane of its type. The package is added even if the queue
+    is full; call makeRoom() first to apply the overflow policy.
+    @param package The package to move.
+    */
+   void PackageQueue::push(Package && package) {
+      const std::size_t size = sizeOf(package);
+      const Lane lane = laneOf(package.getType());
+      lanes[lane].push(Entry{std::move(package), size, nextOrder++});
+      count++;
+      totalBytes += size;
+   }
+
+   /**
+    Gets the next package, the first one in the highest priority lane with packages.
+    The queue must not be empty.
+    @return The next package.
+    */
+   Package & PackageQueue::front() {
+      return lanes[firstLane()].front().package;
+   }
+
+   /**
+    Removes the next package, the one front() returns. The queue must not be empty.
+    */
+   void PackageQueue::pop() {
+      std::queue<Entry> & lane = lanes[firstLane()];
+      totalBytes -= lane.front().bytes;
+      lane.pop();
+      count--;
+   }
+
+   /**
+    Use to query if the queue is empty.
+    @return Returns true if there are no packages in any lane.
+    */
+   bool PackageQueue::empty() const {
+      return count == 0;
+   }
+
+   /**
+    Gets the number of packages in the queue.
+    @return The number of packages in all the lanes.
+    */
+   std::size_t PackageQueue::size() const {
+      return count;
+   }
+
+   /**
+    Gets the number of packages in the lane of a package type.
+    @param type The package type.
+    @return The number of packages in the lane.
+    */
+   std::size_t PackageQueue::size(Package::Type type) const {
+      return lanes[laneOf(type)].size();
+   }
+
+   /**
+    Gets the size of the packages in the queue, as counted against the byte limit.
+    @return The bytes in all the lanes.
+    */
+   std::size_t PackageQueue::bytes() const {
+      return totalBytes;
+   }
+
+   /**
+    Use to query if there are packages other than data in the queue.
+    @return Returns true if some lane above the data lane has packages.
+    */
+   bool PackageQueue::hasPriorityPackages() const {
+      return count > lanes[DataLane].size();
+   }
+
+   /**
+    Removes all the packages. Removed packages are not counted as dropped.
+    */
+   void PackageQueue::clear() {
+      for (std::queue<Entry> & lane : lanes) {
+         std::queue<Entry>().swap(lane);
+      }
+      count = 0;
+      totalBytes = 0;
+   }
+
+   /**
+    Sets how many packages the queue holds at most.
+    @param packages The limit, 0 for no limit.
+    */
+   void PackageQueue::setPackageLimit(std::size_t packages) {
+      packageLimit = packages;
+   }
+
+   /**
+    Sets how many bytes of packages the queue holds at most.
+    @param limit The limit, 0 for no limit.
+    */
+   void PackageQueue::setByteLimit(std::size_t limit) {
+      byteLimit = limit;
+   }
+
+   /**
+    Sets what is done when a package arrives to a full queue.
+    @param policy The overflow policy.
+    */
+   void PackageQueue::setOverflow(Overflow policy) {
+      overflow = policy;
+   }
+
+   /**
+    Gets what is done when a package arrives to a full queue.
+    @return The overflow policy.
+    */
+   PackageQueue::Overflow PackageQueue::getOverflow() const {
+      return overflow;
+   }
+
+   /**
+    Use to query if the queue has a limit.
+    @return Returns true if the packages or the bytes are limited.
+    */
+   bool PackageQueue::isLimited() const {
+      return packageLimit > 0 || byteLimit > 0;
+   }
+
+   /**
+    Use to query if a package fits into the queue without exceeding the limits.
+    An empty queue always has space, so that a package larger than the byte limit is not refused forever.
+    @param package The package.
+    @return Returns true if the package fits.
+    */
+   bool PackageQueue::hasSpaceFor(const Package & package) const {
+      if (count == 0) {
+         return true;
+      }
+      return (packageLimit == 0 || count < packageLimit) && (byteLimit == 0 || totalBytes + sizeOf(package) <= byteLimit);
+   }
+
+   /**
+    Applies the overflow policy before a package is added, if the package does not fit into the queue.
+    Packages dropped from the queue to make room, and the package itself if it is to be dropped, are counted.
+    @param package The package to add.
+    @return Returns false if the package must be dropped instead of added.
+    */
+   bool PackageQueue::makeRoom(const Package & package) {
+      if (hasSpaceFor(package)) {
+         return true;
+      }
+      const Lane lane = laneOf(package.getType());
+      switch (overflow) {
+         case Overflow::Block:
+            if (lane != DataLane) {
+               return true;
+            }
+            break;
+         case Overflow::DropNewest:
+            break;
+         case Overflow::DropOldest:
+            while (!hasSpaceFor(package)) {
+               drop(oldestLane());
+            }
+            return true;
+         case Overflow::DropByType:
+            while (!hasSpaceFor(package) && lastLane() > lane) {
+               drop(lastLane());
+            }
+            if (hasSpaceFor(package)) {
+               return true;
+            }
+            break;
+      }
+      droppedCount++;
+      return false;
+   }
+
+   /**
+    Gets the number of packages dropped because the queue was full.
+    @return The number of packages dropped since the queue was created.
+    */
+   unsigned long long PackageQueue::dropped() const {
+      return droppedCount;
+   }
+
+   /**
+    Gets the overflow policy by its name in the node configuration.
+    @param policy The name: block, drop-newest, drop-oldest or drop-type.
+    @return The policy.
+    @throws std::runtime_error if the name is not a policy.
+    */
+   PackageQueue::Overflow PackageQueue::overflowFrom(const std::string & policy) {
+      if (policy == "block") {
+         return Overflow::Block;
+      } else if (policy == "drop-newest") {
+         return Overflow::DropNewest;
+      } else if (policy == "drop-oldest") {
+         return Overflow::DropOldest;
+      } else if (policy == "drop-type") {
+         return Overflow::DropByType;
+      }
+      throw std::runtime_error("Unknown queue overflow policy: " + policy);
+   }
+
+   /**
+    Gets the lane of a package type. Packages with no type go with the data.
+    @param type The package type.
+    @return The lane.
+    */
+   PackageQueue::Lane PackageQueue::laneOf(Package::Type type) {
+      switch (type) {
+         case Package::Control:
+            return ControlLane;
+         case Package::Acknowledgement:
+            return AcknowledgementLane;
+         case Package::Configuration:
+            return ConfigurationLane;
+         default:
+            return DataLane;
+      }
+   }
+
+   /**
+    Gets the size of a package counted against the byte limit: the payload and the package object.
+    A JSON value payload is counted by the size of the JSON text it was received in. A parsed payload object,
+    or a JSON value payload set by a handler, is counted as the package object only.
+    @param package The package.
+    @return The size in bytes.
+    */
+   std::size_t PackageQueue::sizeOf(const Package & package) {
+      return sizeof(Package) + package.payloadSize();
+   }
+
+   /**
+    Gets the highest priority lane with packages.
+    @return The lane, or the data lane if the queue is empty.
+    */
+   PackageQueue::Lane PackageQueue::firstLane() const {
+      for (int lane = ControlLane; lane < DataLane; lane++) {
+         if (!lanes[lane].empty()) {
+            return static_cast<Lane>(lane);
+         }
+      }
+      return DataLane;
+   }
+
+   /**
+    Gets the lane with the package that has waited the longest. The queue must not be empty.
+    @return The lane.
+    */
+   PackageQueue::Lane PackageQueue::oldestLane() const {
+      Lane oldest = LaneCount;
+      for (int lane = ControlLane; lane < LaneCount; lane++) {
+         if (!lanes[lane].empty() && (oldest == LaneCount || lanes[lane].front().order < lanes[oldest].front().order)) {
+            oldest = static_cast<Lane>(lane);
+         }
+      }
+      return oldest;
+   }
+
+   /**
+    Gets the lowest priority lane with packages.
+    @return The lane, or the control lane if the queue is empty.
+    */
+   PackageQueue::Lane PackageQueue::lastLane() const {
+      for (int lane = DataLane; lane > ControlLane; lane--) {
+         if (!lanes[lane].empty()) {
+            return static_cast<Lane>(lane);
+         }
+      }
+      return ControlLane;
+   }
+
+   /**
+    Drops the first package of a lane to make room, and counts it.
+    @param lane The lane, which must not be empty.
+    */
+   void PackageQueue::drop(Lane lane) {
+      std::queue<Entry> & packages = lanes[lane];
+      LOG(INFO) << "Queue full, dropping package " << packages.front().package.getUuid();
+      totalBytes -= packages.front().bytes;
+      packages.pop();
+      count--;
+      droppedCount++;
+   }
+
+} //namespace
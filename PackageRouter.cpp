@@ -0,0 +1,178 @@
+//
+//  PackageRouter.cpp
+//  ProcessorNode
+//
+
+#include <boost/algorithm/string.hpp>
+
+#include <g3log/g3log.hpp>
+
+#include <ProcessorNode/PackageRouter.h>
+#include <ProcessorNode/DataItem.h>
+
+namespace OHARBase {
+
+   const std::string PackageRouter::TAG{"Router "};
+
+   /**
+    Parses the routing rules into the rule set, replacing the previous rules.
+    See the class documentation for the syntax of the rules.
+    @param ruleString The routing rules.
+    @throws std::runtime_error if a rule or an address cannot be parsed.
+    */
+   void PackageRouter::parse(const std::string & ruleString) {
+      rules.clear();
+      std::vector<std::string> ruleStrings;
+      boost::split(ruleStrings, ruleString, boost::is_any_of(";"));
+      for (std::string & ruleStr : ruleStrings) {
+         boost::trim(ruleStr);
+         if (ruleStr.empty()) {
+            continue;
+         }
+         std::size_t arrow = ruleStr.find("->");
+         if (arrow == std::string::npos) {
+            throw std::runtime_error("Routing rule has no addresses: " + ruleStr);
+         }
+         Rule rule;
+         rule.needsPayload = false;
+         std::vector<std::string> conditionStrings;
+         boost::split(conditionStrings, ruleStr.substr(0, arrow), boost::is_any_of("&"));
+         for (std::string & conditionStr : conditionStrings) {
+            boost::trim(conditionStr);
+            Condition condition;
+            condition.type = Package::NoType;
+            std::size_t pos = std::string::npos;
+            if ((pos = conditionStr.find("^=")) != std::string::npos && conditionStr.substr(0, pos) == "id") {
+               condition.kind = Condition::IdPrefix;
+               condition.value = conditionStr.substr(pos + 2);
+               rule.needsPayload = true;
+            } else if ((pos = conditionStr.find('=')) != std::string::npos) {
+               std::string key = conditionStr.substr(0, pos);
+               condition.value = conditionStr.substr(pos + 1);
+               if (key == "type") {
+                  condition.kind = Condition::TypeEquals;
+                  Package typeParser(boost::uuids::nil_uuid());
+                  typeParser.setTypeFromString(condition.value);
+                  condition.type = typeParser.getType();
+                  if (condition.type == Package::NoType) {
+                     throw std::runtime_error("Unknown package type in routing rule: " + condition.value);
+                  }
+               } else if (boost::starts_with(key, "field.") && key.length() > 6) {
+                  condition.kind = Condition::FieldEquals;
+                  condition.name = key.substr(6);
+                  rule.needsPayload = true;
+               } else {
+                  throw std::runtime_error("Unknown condition in routing rule: " + conditionStr);
+               }
+            } else {
+               throw std::runtime_error("Invalid condition in routing rule: " + conditionStr);
+            }
+            rule.conditions.push_back(condition);
+         }
+         std::vector<std::string> addresses;
+         boost::split(addresses, ruleStr.substr(arrow + 2), boost::is_any_of(","));
+         for (std::string & address : addresses) {
+            boost::trim(address);
+            std::vector<std::string> strs;
+            boost::split(strs, address, boost::is_any_of(":"));
+            if (strs.size() != 2) {
+               throw std::runtime_error("Invalid address in routing rule: " + address);
+            }
+            rule.targets.emplace_back(boost::asio::ip::address::from_string(strs.at(0)), std::stoi(strs.at(1)));
+         }
+         rules.push_back(std::move(rule));
+      }
+      LOG(INFO) << TAG << "Parsed " << rules.size() << " routing rules.";
+   }
+
+   /**
+    Use to query if there are any routing rules.
+    @return Returns true if there are no rules.
+    */
+   bool PackageRouter::isEmpty() const {
+      return rules.empty();
+   }
+
+   /**
+    Gets the number of routing rules.
+    @return The number of rules.
+    */
+   std::size_t PackageRouter::ruleCount() const {
+      return rules.size();
+   }
+
+   /**
+    Finds the addresses to send the package to, by evaluating the rules in order.
+    @param package The package to route.
+    @return The addresses of the first matching rule, or nullptr if no rule matched.
+    */
+   const std::vector<boost::asio::ip::udp::endpoint> * PackageRouter::route(const Package & package) const {
+      nlohmann::json parsed;
+      const nlohmann::json * payload = &parsed;
+      bool payloadParsed = false;
+      for (const Rule & rule : rules) {
+         if (rule.needsPayload && !payloadParsed) {
+            // JSON value payloads are already parsed, parsed DataItem payloads have no JSON string to parse.
+            if (package.getPayloadJson()) {
+               payload = package.getPayloadJson();
+            } else if (!package.getPayloadObject()) {
+               parsed = nlohmann::json::parse(package.getPayloadString(), nullptr, false);
+            }
+            payloadParsed = true;
+         }
+         bool allMatch = true;
+         for (const Condition & condition : rule.conditions) {
+            if (!matches(condition, package, *payload)) {
+               allMatch = false;
+               break;
+            }
+         }
+         if (allMatch) {
+            return &rule.targets;
+         }
+      }
+      return nullptr;
+   }
+
+   /**
+    Checks if a condition matches the package.
+    @param condition The condition to check.
+    @param package The package to check.
+    @param payload The payload of the package parsed as JSON, if some rule needs it.
+    @return Returns true if the condition matches.
+    */
+   bool PackageRouter::matches(const Condition & condition, const Package & package, const nlohmann::json & payload) const {
+      switch (condition.kind) {
+         case Condition::TypeEquals: {
+            return package.getType() == condition.type;
+         }
+         case Condition::IdPrefix: {
+            const DataItem * item = package.getPayloadObject();
+            if (item) {
+               return boost::starts_with(item->getId(), condition.value);
+            }
+            if (payload.is_object()) {
+               auto id = payload.find("id");
+               if (id != payload.end() && id->is_string()) {
+                  return boost::starts_with(id->get_ref<const std::string &>(), condition.value);
+               }
+            }
+            return false;
+         }
+         case Condition::FieldEquals: {
+            if (payload.is_object()) {
+               auto field = payload.find(condition.name);
+               if (field != payload.end()) {
+                  if (field->is_string()) {
+                     return field->get_ref<const std::string &>() == condition.value;
+                  }
+                  return field->dump() == condition.value;
+               }
+            }
+            return false;
+         }
+      }
+      return false;
+   }
+
+} //namespace
@@ -0,0 +1,254 @@
+//
+//  PackageScanner.cpp
+//  ProcessorNode
+//
+
+#include <boost/uuid/string_generator.hpp>
+
+#include <ProcessorNode/PackageScanner.h>
+
+namespace OHARBase {
+
+   /** How deep objects and arrays may be nested in a payload scanned. */
+   static const std::size_t MAX_DEPTH{64};
+
+   /**
+    Reads the fields of a data package from its JSON text, keeping the payload as raw JSON text.
+    @param data The JSON text of the package.
+    @param length Length of the text.
+    @param package The package to read the fields into, untouched if false is returned.
+    @return Returns true if the package was read, false if it is not a data package or the text
+    must be parsed as usual.
+    */
+   bool PackageScanner::scan(const char * data, std::size_t length, Package & package) {
+      const char * end = data + length;
+      const char * position = skipSpace(data, end);
+      if (position == end || *position != '{') {
+         return false;
+      }
+      std::string_view uuid;
+      std::string_view type;
+      std::uint64_t port = 0;
+      std::uint64_t stream = 0;
+      std::uint64_t sequence = 0;
+      std::uint64_t base = 0;
+      bool hasStream = false;
+      bool hasSequence = false;
+      const char * payloadBegin = nullptr;
+      const char * payloadEnd = nullptr;
+      position = skipSpace(position + 1, end);
+      while (true) {
+         if (position == end || *position != '"') {
+            return false;
+         }
+         const char * keyEnd = skipString(position, end);
+         if (!keyEnd) {
+            return false;
+         }
+         const std::string_view key(position + 1, static_cast<std::size_t>(keyEnd - position - 2));
+         position = skipSpace(keyEnd, end);
+         if (position == end || *position != ':') {
+            return false;
+         }
+         position = skipSpace(position + 1, end);
+         const char * valueEnd = skipValue(position, end);
+         if (!valueEnd) {
+            return false;
+         }
+         if (key == "payload") {
+            payloadBegin = position;
+            payloadEnd = valueEnd;
+         } else if (key == "package") {
+            if (!readString(position, valueEnd, uuid)) {
+               return false;
+            }
+         } else if (key == "type") {
+            if (!readString(position, valueEnd, type)) {
+               return false;
+            }
+         } else if (key == "sender-listening-port") {
+            std::string_view digits;
+            if (!readString(position, valueEnd, digits) || !readNumber(digits.data(), digits.data() + digits.size(), port) || port > 0xFFFF) {
+               return false;
+            }
+         } else if (key == "stream") {
+            if (!readNumber(position, valueEnd, stream) || stream > 0xFFFFFFFF) {
+               return false;
+            }
+            hasStream = true;
+         } else if (key == "sequence") {
+            if (!readNumber(position, valueEnd, sequence)) {
+               return false;
+            }
+            hasSequence = true;
+         } else if (key == "base") {
+            if (!readNumber(position, valueEnd, base)) {
+               return false;
+            }
+         }
+         position = skipSpace(valueEnd, end);
+         if (position == end) {
+            return false;
+         }
+         if (*position == '}') {
+            break;
+         }
+         if (*position != ',') {
+            return false;
+         }
+         position = skipSpace(position + 1, end);
+      }
+      if (skipSpace(position + 1, end) != end || uuid.empty() || type != "data") {
+         return false;
+      }
+      boost::uuids::uuid id;
+      try {
+         id = boost::uuids::string_generator()(uuid.begin(), uuid.end());
+      } catch (const std::exception &) {
+         return false;
+      }
+      Package scanned(id);
+      scanned.setType(Package::Data);
+      if (payloadBegin) {
+         scanned.setPayloadRawJson(std::string(payloadBegin, payloadEnd));
+      }
+      if (port != 0) {
+         scanned.setOrigin(boost::asio::ip::udp::endpoint(boost::asio::ip::address_v4(), static_cast<unsigned short>(port)));
+      }
+      if (hasStream && hasSequence) {
+         scanned.setSequence(static_cast<std::uint32_t>(stream), sequence);
+         scanned.setSequenceBase(base);
+      }
+      package = std::move(scanned);
+      return true;
+   }
+
+   /**
+    Skips the white space.
+    @param position Where to start.
+    @param end The end of the text.
+    @return The first character not white space, or the end.
+    */
+   const char * PackageScanner::skipSpace(const char * position, const char * end) {
+      while (position != end && (*position == ' ' || *position == '\t' || *position == '\n' || *position == '\r')) {
+         position++;
+      }
+      return position;
+   }
+
+   /**
+    Skips a JSON string.
+    @param position The opening quote of the string.
+    @param end The end of the text.
+    @return The character after the closing quote, or nullptr if the string does not end.
+    */
+   const char * PackageScanner::skipString(const char * position, const char * end) {
+      for (position++; position != end; position++) {
+         if (*position == '\\') {
+            if (++position == end) {
+               return nullptr;
+            }
+         } else if (*position == '"') {
+            return position + 1;
+         }
+      }
+      return nullptr;
+   }
+
+   /**
+    Skips a JSON value. Objects and arrays are checked for matching brackets only.
+    @param position The first character of the value.
+    @param end The end of the text.
+    @return The character after the value, or nullptr if the value is not complete.
+    */
+   const char * PackageScanner::skipValue(const char * position, const char * end) {
+      if (position == end) {
+         return nullptr;
+      }
+      if (*position == '"') {
+         return skipString(position, end);
+      }
+      if (*position == '{' || *position == '[') {
+         char closing[MAX_DEPTH];
+         std::size_t depth = 0;
+         while (position != end) {
+            const char c = *position;
+            if (c == '"') {
+               position = skipString(position, end);
+               if (!position) {
+                  return nullptr;
+               }
+               continue;
+            }
+            if (c == '{' || c == '[') {
+               if (depth == MAX_DEPTH) {
+                  return nullptr;
+               }
+               closing[depth++] = (c == '{' ? '}' : ']');
+            } else if (c == '}' || c == ']') {
+               if (depth == 0 || closing[depth - 1] != c) {
+                  return nullptr;
+               }
+               if (--depth == 0) {
+                  return position + 1;
+               }
+            }
+            position++;
+         }
+         return nullptr;
+      }
+      // A number or a literal.
+      const char * begin = position;
+      while (position != end && *position != ',' && *position != '}' && *position != ']'
+             && *position != ' ' && *position != '\t' && *position != '\n' && *position != '\r') {
+         position++;
+      }
+      return position != begin ? position : nullptr;
+   }
+
+   /**
+    Reads a JSON string without escapes.
+    @param begin The opening quote of the string.
+    @param end The character after the closing quote.
+    @param value The string read.
+    @return Returns false if the value is not a string, or it has escapes.
+    */
+   bool PackageScanner::readString(const char * begin, const char * end, std::string_view & value) {
+      if (end - begin < 2 || *begin != '"') {
+         return false;
+      }
+      for (const char * position = begin + 1; position != end - 1; position++) {
+         if (*position == '\\') {
+            return false;
+         }
+      }
+      value = std::string_view(begin + 1, static_cast<std::size_t>(end - begin - 2));
+      return true;
+   }
+
+   /**
+    Reads an unsigned integer.
+    @param begin The first digit.
+    @param end The character after the last digit.
+    @param value The number read.
+    @return Returns false if the value is not an unsigned integer, or it is too large.
+    */
+   bool PackageScanner::readNumber(const char * begin, const char * end, std::uint64_t & value) {
+      if (begin == end) {
+         return false;
+      }
+      value = 0;
+      for (const char * position = begin; position != end; position++) {
+         if (*position < '0' || *position > '9') {
+            return false;
+         }
+         const std::uint64_t digit = static_cast<std::uint64_t>(*position - '0');
+         if (value > (UINT64_MAX - digit) / 10) {
+            return false;
+         }
+         value = value * 10 + digit;
+      }
+      return true;
+   }
+
+} //namespace
@@ -10,6 +10,7 @@
 #include <iostream>
 
 #include <boost/uuid/uuid_io.hpp>
+#include <boost/algorithm/string.hpp>
 
 #include <g3log/g3log.hpp>
 
@@ -21,6 +22,7 @@
 #include <ProcessorNode/NodeConfiguration.h>
 #include <ProcessorNode/ConfigurationFileReader.h>
 #include <ProcessorNode/ConfigurationHandler.h>
+#include <ProcessorNode/UuidGenerator.h>
 
 namespace OHARBase {
 
@@ -103,12 +105,108 @@ bool ProcessorNode::configure(const std::string & configFile) {
             showUIMessage("Configuration for node:");
             std::string cvalue = config->getValue(ConfigurationDataItem::CONF_INPUTADDR);
             setInputSource(cvalue);
+            cvalue = config->getValue(ConfigurationDataItem::CONF_INPUT_BATCH);
+            if (networkReader && cvalue.length() > 0) {
+               networkReader->setBatchSize(std::stoi(cvalue));
+               showUIMessage("Receiving datagrams in batches of " + cvalue);
+            }
+            cvalue = config->getValue(ConfigurationDataItem::CONF_INPUT_SHARDS);
+            if (networkReader && cvalue.length() > 0) {
+               networkReader->setShardCount(std::stoi(cvalue));
+               showUIMessage("Reading the input port with " + std::to_string(networkReader->getShardCount()) + " sockets");
+            }
+            cvalue = config->getValue(ConfigurationDataItem::CONF_CUT_THROUGH);
+            if (networkReader && cvalue == "true") {
+               networkReader->setCutThrough(true);
+               showUIMessage("Passing the payloads of data packages through without parsing them");
+            }
+            cvalue = config->getValue(ConfigurationDataItem::CONF_UUID_VERSION);
+            if (cvalue.length() > 0) {
+               UuidGenerator::setVersion(UuidGenerator::versionFrom(cvalue));
+               showUIMessage("Generating version " + cvalue + " uuids for packages");
+            }
             cvalue = config->getValue(ConfigurationDataItem::CONF_CONFINADDR);
             setConfigurationInputSource(cvalue);
             cvalue = config->getValue(ConfigurationDataItem::CONF_OUTPUTADDR);
             setOutputSink(cvalue);
+            // The next node sends the acks of datagrams to the input port of this node as datagrams,
+            // and an input reading TCP connections or a shared memory ring has no socket for them.
+            if (networkReader && networkReader->getTransport() != Networker::Transport::Datagram
+                && config->getValue(ConfigurationDataItem::CONF_USE_ACK).length() > 0) {
+               std::vector<std::string> addresses;
+               boost::split(addresses, cvalue, boost::is_any_of(","));
+               for (std::string & address : addresses) {
+                  boost::trim(address);
+                  if (address.length() > 0 && address != "null" && Networker::transportOf(address) == Networker::Transport::Datagram) {
+                     throw std::runtime_error("use-ack with the datagram output " + address + " needs a datagram input to receive the acks");
+                  }
+               }
+            }
+            cvalue = config->getValue(ConfigurationDataItem::CONF_ROUTES);
+            if (networkWriter && cvalue.length() > 0) {
+               networkWriter->setRoutes(cvalue);
+               showUIMessage("Routing packages with rules " + cvalue);
+            }
+            cvalue = config->getValue(ConfigurationDataItem::CONF_ACK_RETRIES);
+            if (networkWriter && cvalue.length() > 0) {
+               networkWriter->setMaxResends(std::stoi(cvalue));
+               showUIMessage("Giving up packages not acknowledged after " + cvalue + " resends");
+            }
+            cvalue = config->getValue(ConfigurationDataItem::CONF_ACK_WINDOW);
+            if (networkWriter && cvalue.length() > 0) {
+               networkWriter->setWindow(std::stoul(cvalue));
+               showUIMessage("Sending at most " + cvalue + " packages not acknowledged to a destination");
+            }
+            cvalue = config->getValue(ConfigurationDataItem::CONF_OUTPUT_BATCH);
+            if (networkWriter && cvalue.length() > 0) {
+               networkWriter->setBatchSize(std::stoi(cvalue));
+               showUIMessage("Sending packages in batches of " + cvalue);
+            }
+            cvalue = config->getValue(ConfigurationDataItem::CONF_OUTPUT_RATE);
+            if (networkWriter && cvalue.length() > 0) {
+               networkWriter->setRates(cvalue);
+               showUIMessage("Limiting the sending rate to " + cvalue);
+            }
             cvalue = config->getValue(ConfigurationDataItem::CONF_CONFOUTADDR);
             createConfigurationOutputWriter();
+            cvalue = config->getValue(ConfigurationDataItem::CONF_MAX_PACKAGE_SIZE);
+            if (cvalue.length() > 0) {
+               std::size_t maxSize = std::stoul(cvalue);
+               if (networkReader) networkReader->setMaxPackageSize(maxSize);
+               if (networkWriter) networkWriter->setMaxPackageSize(maxSize);
+               showUIMessage("Maximum package size is " + cvalue + " bytes");
+            }
+            cvalue = config->getValue(ConfigurationDataItem::CONF_QUEUE_LIMIT);
+            if (cvalue.length() > 0) {
+               std::size_t limit = std::stoul(cvalue);
+               if (networkReader) networkReader->setQueueLimit(limit);
+               if (networkWriter) networkWriter->setQueueLimit(limit);
+               showUIMessage("Input and send queues hold at most " + cvalue + " packages");
+            }
+            cvalue = config->getValue(ConfigurationDataItem::CONF_QUEUE_BYTES);
+            if (cvalue.length() > 0) {
+               std::size_t bytes = std::stoul(cvalue);
+               if (networkReader) networkReader->setQueueBytes(bytes);
+               if (networkWriter) networkWriter->setQueueBytes(bytes);
+               showUIMessage("Input and send queues hold at most " + cvalue + " bytes");
+            }
+            cvalue = config->getValue(ConfigurationDataItem::CONF_QUEUE_OVERFLOW);
+            if (cvalue.length() > 0) {
+               PackageQueue::Overflow policy = PackageQueue::overflowFrom(cvalue);
+               if (networkReader) networkReader->setOverflow(policy);
+               if (networkWriter) networkWriter->setOverflow(policy);
+               showUIMessage("When a queue is full: " + cvalue);
+            }
+            cvalue = config->getValue(ConfigurationDataItem::CONF_OUTPUT_LOG);
+            if (networkWriter && cvalue.length() > 0) {
+               networkWriter->setLog(cvalue);
+               showUIMessage("Keeping the packages sent in " + cvalue + " until delivered");
+            }
+            cvalue = config->getValue(ConfigurationDataItem::CONF_OUTPUT_FORMAT);
+            if (networkWriter && cvalue.length() > 0) {
+               networkWriter->setFormat(Networker::formatFrom(cvalue));
+               showUIMessage("Sending packages in " + cvalue + " format");
+            }
             cvalue = config->getValue(ConfigurationDataItem::CONF_INPUTFILE);
             setDataFileName(cvalue);
             cvalue = config->getValue(ConfigurationDataItem::CONF_OUTPUTFILE);
@@ -147,7 +245,8 @@ std::string ProcessorNode::getConfigItemValue(const std::string & itemName) cons
 
 /** Sets the address of the input source for the Node. This is the port where
  data is read. Node listens for arrivind data from this port and then handles it using the DataHandler objects.
- @param port The port number to listen to, e.g. "1234". */
+ @param port The port number to listen to, e.g. "1234", or "tcp://1234" for accepting TCP connections to the port,
+ or "shm://name" for reading from a shared memory ring written by a node on the same host. */
 void ProcessorNode::setInputSource(const std::string & port) {
    if (networkReader) {
       delete networkReader;
@@ -157,8 +256,15 @@ void ProcessorNode::setInputSource(const std::string & port) {
       std::stringstream sstream;
       sstream << "Reading data from port " << port;
       logAndShowUIMessage(sstream.str());
-      int iPort = std::stoi(port);
-      networkReader = new NetworkReader(iPort, *this, io_service);
+      Networker::Transport transport = Networker::transportOf(port);
+      if (transport == Networker::Transport::SharedMemory) {
+         networkReader = new NetworkReader(0, *this, io_service);
+         networkReader->setSharedMemoryRing(Networker::addressWithoutScheme(port));
+      } else {
+         int iPort = std::stoi(Networker::addressWithoutScheme(port));
+         networkReader = new NetworkReader(iPort, *this, io_service);
+         networkReader->setTransport(transport);
+      }
    } else {
       showUIMessage("This node has no previous node to read data from.");
    }
@@ -209,6 +315,7 @@ void ProcessorNode::createConfigurationOutputWriter() {
          // The host and port number does not matter since config Packages always must contain the address where to
          // send the configuration responses.
          configWriter = new NetworkWriter("localhost", 12345, io_service);
+         configWriter->setObserver(this);
       }
    }
 }
@@ -222,8 +329,11 @@ const NodeConfiguration & ProcessorNode::getConfiguration() const {
 }
 
 /** Sets the address of the output sink for the Node. This is the hostname and port where
- data is written to.
- @param hostName The host name, e.g. "127.0.0.1:1234" or "130.231.44.121:1234". */
+ data is written to. Several addresses can be given, separated by commas. Then each package
+ is sent to all of the addresses.
+ @param hostName The host name, e.g. "127.0.0.1:1234" or "130.231.44.121:1234,130.231.44.122:1234".
+ Addresses starting with tcp://, e.g. "tcp://130.231.44.121:1234", are sent to over TCP connections,
+ and addresses starting with shm://, e.g. "shm://filter2", through shared memory rings. */
 void ProcessorNode::setOutputSink(const std::string & hostName) {
    // Create a new Network object for sending data to the datagram socket.
    if (networkWriter) {
@@ -234,7 +344,18 @@ void ProcessorNode::setOutputSink(const std::string & hostName) {
       std::stringstream sstream;
       sstream << "Sending data to " << hostName;
       showUIMessage(sstream.str());
-      networkWriter = new NetworkWriter(hostName, io_service);
+      std::vector<std::string> addresses;
+      boost::split(addresses, hostName, boost::is_any_of(","));
+      for (std::string & address : addresses) {
+         boost::trim(address);
+      }
+      networkWriter = new NetworkWriter(addresses.front(), io_service);
+      networkWriter->setObserver(this);
+      for (std::size_t index = 1; index < addresses.size(); index++) {
+         if (addresses[index].length() > 0) {
+            networkWriter->addDestination(addresses[index]);
+         }
+      }
    } else {
       showUIMessage("This node has no next node to send data to.");
    }
@@ -255,6 +376,7 @@ void ProcessorNode::setOutputSink(const std::string & hostName, int portNumber)
       sstream << "Sending data to host " << hostName << ":" << portNumber;
       logAndShowUIMessage(sstream.str());
       networkWriter = new NetworkWriter(hostName, portNumber, io_service);
+      networkWriter->setObserver(this);
    } else {
       showUIMessage("This node has no next node to send data to.");
    }
@@ -445,7 +567,7 @@ void ProcessorNode::start() {
                         if (cmd == "ping") {
                            p.setType(Package::Control);
                            p.setPayload(cmd);
-                           sendData(p);
+                           sendData(std::move(p));
                            showUIMessage("Ping sent to next node (if any).");
                         } else if (cmd == "readfile") {
                            queuePackageCounts.clear();
@@ -454,7 +576,7 @@ void ProcessorNode::start() {
                               showUIMessage("Handling command to read a file " + dataFileName);
                               p.setType(Package::Control);
                               p.setPayload(cmd);
-                              passToHandlers(p);
+                              passToHandlers(std::move(p));
                            } else {
                               showUIMessage("Readfile command came, but no data file specified for this node.");
                            }
@@ -462,13 +584,14 @@ void ProcessorNode::start() {
                            if (cmd == "shutdown") {
                               p.setType(Package::Control);
                               p.setPayload(cmd);
-                              sendData(p);
+                              sendData(std::move(p));
                               logAndShowUIMessage("Sent the shutdown command to next node (if any).");
                            }
                            logAndShowUIMessage("Initiated quitting of this node...");
                            running = false;
                            nodeInitiatedShutdownStarted = true;
                            condition.notify_all();
+                           wakeIncomingHandler();
                            std::this_thread::sleep_for(std::chrono::milliseconds(100));
                         }
                      }
@@ -500,6 +623,7 @@ void ProcessorNode::stop() {
    running = false;
    LOG(INFO) << TAG << "Notify all";
    condition.notify_all();
+   wakeIncomingHandler();
 //   LOG(INFO) << TAG << "Stopping io service...";
 //   if (!io_service.stopped()) {
 //      io_service.stop();
@@ -568,28 +692,39 @@ void ProcessorNode::handleCommand(const std::string & aCommand) {
 }
 
 /** Method sends the data to the next node by using the NetworkWriter object.
+ A copy of the package, sharing the payload with it, is sent as in sendData(Package &&).
  @param data The data package to send to the next Node. */
 void ProcessorNode::sendData(Package & data) {
+   sendData(Package(data));
+}
+
+/** Method sends the data to the next node by using the NetworkWriter object.
+ The package is moved to the writer, so it is not copied on the way.
+ @param data The data package to send to the next Node. */
+void ProcessorNode::sendData(Package && data) {
    // Need to set the origin of the package before sending it.
    // The origin is the listening port of the Node. Receiver will get the ip address of
    // the sender host and add that to the origin port number from the JSON.
 //   if (!data.hasOrigin()) {
-   data.setOrigin(listeningPort());
+   data.setOrigin(boost::asio::ip::udp::endpoint(boost::asio::ip::address_v4(), listeningPort()));
 //   }
    if (networkWriter) {
       showUIMessage("Output handling a package of type " + data.getTypeAsString());
       LOG(INFO) << TAG << "Telling network writer to handle a package.";
-      networkWriter->write(data);
+      networkWriter->write(std::move(data));
       updatePackageCountInQueue("net-out", networkWriter->packagesInQueue());
+      if (networkWriter->packagesDropped() > 0) {
+         updatePackageCountInQueue("net-out-dropped", static_cast<int>(networkWriter->packagesDropped()));
+      }
    // If node hasn't got the next node, it uses the config writer to send config packages (only).
    } else if (configWriter) {
       if (data.getType() == Package::Configuration) {
          showUIMessage("Sending configuration response message to Configurator.");
          LOG(INFO) << "No networkWriter so using configWriter to send a response to Configurator";
-         configWriter->write(data);
+         configWriter->write(std::move(data));
       } else if (data.getType() == Package::Acknowledgement) {
          logAndShowUIMessage("ackhandling: Handling ack message about data packages.");
-         configWriter->write(data);
+         configWriter->write(std::move(data));
       }
    }
 }
@@ -609,7 +744,7 @@ void ProcessorNode::threadFunc() {
    /*
     What is happening here in this thread...
     - while (1) the thread (node) is running:
-    - wait for someone to wake the thread (someone calls condition.notify_all)...
+    - wait for someone to wake the thread (someone calls incoming.notify_all)...
     - waiting is over. Check if we are still running
     (someone might have set the running to false while waiting the thread to be awoken)
     - if running, then get the next package from the network reader
@@ -629,11 +764,13 @@ void ProcessorNode::threadFunc() {
       LOG(INFO) << TAG << "Receive queue empty, waiting...";
       {
          // Wait until the condition variable is notified that something happened.
-         std::unique_lock<std::mutex> ulock(guard);
-         condition.wait(ulock, [this] { return this->hasIncoming || !running; });
+         std::unique_lock<std::mutex> ulock(incomingGuard);
+         incoming.wait(ulock, [this] { return this->hasIncoming || !running; });
+         // Clear the flag before handling, so that data arriving while handling wakes the thread up again.
+         hasIncoming = false;
       }
       // OK, something happened so if we are still running, check if something came from the network.
-      if (running && hasIncoming) {
+      if (running) {
          LOG(INFO) << "Incoming handler thread starts to handle incoming packages.";
          if (configReader) {
             handlePackagesFrom(*configReader);
@@ -641,8 +778,10 @@ void ProcessorNode::threadFunc() {
          if (networkReader) {
             handlePackagesFrom(*networkReader);
             updatePackageCountInQueue("net-in", networkReader->packagesInQueue());
+            if (networkReader->packagesDropped() > 0) {
+               updatePackageCountInQueue("net-in-dropped", static_cast<int>(networkReader->packagesDropped()));
+            }
          }
-         hasIncoming = false;
       }
    }
    LOG(INFO) << TAG << "Exit incoming data handler thread in ProcessorNode!";
@@ -653,10 +792,11 @@ void ProcessorNode::handlePackagesFrom(NetworkReader & reader) {
    // If package is empty, nothing came.
    while (!package.isEmpty() && running) {
       showUIMessage("Handling a package.");
-      LOG(INFO) << TAG << "Handling a package: " << boost::uuids::to_string(package.getUuid()) << " " << package.getTypeAsString() << ":" << package.getPayloadString();
+      // The size only, so that a payload passed through is not parsed for logging.
+      LOG(INFO) << TAG << "Handling a package: " << boost::uuids::to_string(package.getUuid()) << " " << package.getTypeAsString() << ":" << package.payloadSize() << " bytes";
       if (package.getType() == Package::Control && package.getPayloadString() == "shutdown") {
          showUIMessage("Got shutdown command, forwarding and initiating shutdown.");
-         sendData(package);
+         sendData(std::move(package));
          std::this_thread::sleep_for(std::chrono::milliseconds(200));
          commandGuard.lock();
          command = "quit";
@@ -667,7 +807,7 @@ void ProcessorNode::handlePackagesFrom(NetworkReader & reader) {
       } else if (package.getType() == Package::Acknowledgement) {
          // No need to give ack messages to handlers, just send them to the node who sent the original Package.
          LOG(INFO) << "ackhandling: Node received ack msg, passing to networkwriter";
-         sendData(package);
+         sendData(std::move(package));
          package = reader.read();
       } else {
          if (package.getType() == Package::Control) {
@@ -675,7 +815,7 @@ void ProcessorNode::handlePackagesFrom(NetworkReader & reader) {
             showUIMessage("Control package arrived with command " + package.getPayloadString());
          }
          // Package was either data, configuration or control, so let the handlers handle it.
-         passToHandlers(package);
+         passToHandlers(std::move(package));
          // Check if there are more packages to handle; handle them all while we are here.
          package = reader.read();
       }
@@ -683,48 +823,60 @@ void ProcessorNode::handlePackagesFrom(NetworkReader & reader) {
 }
 
 
-std::string ProcessorNode::listeningPort() const {
-   int port = -1;
+unsigned short ProcessorNode::listeningPort() const {
+   int port = 0;
    if (networkReader) {
       port = networkReader->getPort();
    } else if (configReader) {
       port = configReader->getPort();
    }
-   if (port >= 0) {
-      return std::to_string(port);
-   }
-   return "";
+   return static_cast<unsigned short>(port > 0 ? port : 0);
 }
 
 /** This method takes the incoming data and passes it to be handled by the
  DataHandler objects in the Node. The data is given to all Handlers until one
  returns true, indicating that the package has been handled and should not be passed
  ahead to next handlers anymore. A Handler can of course handle the package and still return false,
- enabling multiple handlers for a single package.
+ enabling multiple handlers for a single package. If no handler kept the package, a copy of it
+ is sent to the next Node.
  @param package The data package to handle. */
 void ProcessorNode::passToHandlers(Package & package) {
+   if (offerToHandlers(package)) {
+      sendData(package);
+   }
+}
+
+/** Passes the package to the handlers as passToHandlers(Package &) does, but if no handler kept
+ the package, it is moved to the writer to send it to the next Node.
+ @param package The data package to handle. */
+void ProcessorNode::passToHandlers(Package && package) {
+   if (offerToHandlers(package)) {
+      sendData(std::move(package));
+   }
+}
+
+/** Gives the package to the handlers until one of them keeps it.
+ @param package The data package to handle.
+ @return Returns true if no handler kept the package and it should be sent to the next Node. */
+bool ProcessorNode::offerToHandlers(Package & package) {
    LOG(INFO) << TAG << "Passing a package to handlers, count: " << handlers.size();
    try {
-      bool packageHeld = false;
       for (DataHandler * handler : handlers) {
          LOG(INFO) << TAG << "Offering data to next Handler...";
-         packageHeld = handler->consume(package);
-         if (packageHeld) {
+         if (handler->consume(package)) {
             LOG(INFO) << TAG << "Handler returned true, not offering forward anymore";
-            break;
+            LOG(INFO) << "Not sending a package since one of the handlers kept it.";
+            return false;
          }
       }
-      if (!packageHeld) {
-         LOG(INFO) << "Sending package.";
-         sendData(package);
-      } else {
-         LOG(INFO) << "Not sending a package since one of the handlers kept it.";
-      }
+      LOG(INFO) << "Sending package.";
+      return true;
    } catch (const std::exception & e) {
       std::stringstream sstream;
       sstream << "ERROR Something went wrong in handling a package: " << e.what() << " with id " << boost::uuids::to_string(package.getUuid());
       logAndShowUIMessage(sstream.str(), ProcessorNodeObserver::EventType::ErrorEvent);
    }
+   return false;
 }
 
 /** Some handlers in Node need to pass packages they handled to the <strong>next</strong>
@@ -788,11 +940,35 @@ void ProcessorNode::updatePackageCountInQueue(const std::string & queueName, int
 /** Implements the NetworkReaderObserver interface. NetworkReader calls this interface
  method when data has been received from the previous Node. The Node then notifies the
  data handling thread (running the threadFunc()) which executes and handles the incoming
- data. */
+ data. May be called from several threads at the same time. */
 void ProcessorNode::receivedData() {
    LOG(INFO) << TAG << "Processor has incoming data!";
-   hasIncoming = true;
-   condition.notify_all();
+   {
+      // The shards of the reader call this from threads of their own. The flag is set under the lock
+      // the handler thread waits with, so that it is not set between the check and the wait.
+      std::lock_guard<std::mutex> flagLock(incomingGuard);
+      hasIncoming = true;
+   }
+   incoming.notify_all();
+}
+
+/** Wakes up the data handling thread to notice that the Node is not running any more. The lock is
+ taken so that the thread does not miss the notification between checking the flags and waiting. */
+void ProcessorNode::wakeIncomingHandler() {
+   {
+      std::lock_guard<std::mutex> flagLock(incomingGuard);
+   }
+   incoming.notify_all();
+}
+// From NetworkReaderObserver:
+/** Called by the NetworkReader when an ack from the next Node has arrived. The ack is
+ given to the NetworkWriter right away, not through the data handling thread, so that
+ acks are not delayed by the data waiting to be handled.
+ @param ack The ack package. */
+void ProcessorNode::receivedAcknowledgement(const Package & ack) {
+   if (networkWriter) {
+      networkWriter->acknowledge(ack);
+   }
 }
 // From NetworkReaderObserver:
 /** Called by the NetworkReader when it could not parse/handle the incoming data.
@@ -806,6 +982,30 @@ void ProcessorNode::errorInData(const std::string & what) {
    showUIMessage(sstream.str(), ProcessorNodeObserver::EventType::ErrorEvent);
 }
 
+// From NetworkWriterObserver:
+/** Called by the NetworkWriter once a second with the rate sent to a destination with a rate limit.
+ @param destination The destination.
+ @param packagesPerSecond Packages sent per second.
+ @param bytesPerSecond Bytes sent per second.
+ @param throttled Packages waiting to be sent to the destination. */
+void ProcessorNode::sendRate(const boost::asio::ip::udp::endpoint & destination, double packagesPerSecond, double bytesPerSecond, std::size_t throttled) {
+   std::stringstream sstream;
+   sstream << "ratelimit: sending to " << destination << " " << static_cast<long>(packagesPerSecond) << " packages/s, " << static_cast<long>(bytesPerSecond) << " bytes/s, " << throttled << " packages throttled.";
+   LOG(INFO) << sstream.str();
+   showUIMessage(sstream.str(), ProcessorNodeObserver::EventType::NotificationEvent);
+}
+
+/** Called by the NetworkWriter when the next node did not acknowledge a package
+ even after resending it. The package is lost, so notify the app/user.
+ @param package The package given up.
+ @param attempts How many times the package was sent. */
+void ProcessorNode::packageNotDelivered(const Package & package, int attempts) {
+   std::stringstream sstream;
+   sstream << "ackhandling: package " << boost::uuids::to_string(package.getUuid()) << " was not acknowledged by " << package.destinationEndpoint() << " after " << attempts << " sends, giving up.";
+   LOG(WARNING) << sstream.str();
+   showUIMessage(sstream.str(), ProcessorNodeObserver::EventType::WarningEvent);
+}
+
 /** Notifies the node observer (assuming it is a (G)UI) of something.
  @param message The message to the user.
  @param e Type of the event. */
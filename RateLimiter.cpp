@@ -0,0 +1,255 @@
+//
+//  RateLimiter.cpp
+//  ProcessorNode
+//
+
+#include <algorithm>
+
+#include <boost/algorithm/string.hpp>
+
+#include <g3log/g3log.hpp>
+
+#include <ProcessorNode/RateLimiter.h>
+
+namespace OHARBase {
+
+   const std::string RateLimiter::TAG{"RateLimiter "};
+   /** How long a burst of tokens may be sent at once. The shorter, the more evenly the sends are spread. */
+   static const std::chrono::microseconds PACING_INTERVAL{1000};
+   /** How often the measured rates are reported. */
+   static const std::chrono::seconds REPORT_INTERVAL{1};
+
+   /**
+    Creates a bucket with no limit.
+    */
+   TokenBucket::TokenBucket()
+   : rate(0), burst(0), tokens(0)
+   {
+   }
+
+   /**
+    Creates a full bucket with the rate.
+    @param ratePerSecond Units per second, 0 for no limit.
+    @param now The current time.
+    */
+   TokenBucket::TokenBucket(double ratePerSecond, std::chrono::steady_clock::time_point now)
+   : rate(ratePerSecond), burst(std::max(1.0, ratePerSecond * std::chrono::duration<double>(PACING_INTERVAL).count())), tokens(burst), updated(now)
+   {
+   }
+
+   /**
+    Use to query if the bucket limits the rate.
+    @return Returns true if the bucket has a rate.
+    */
+   bool TokenBucket::isLimited() const {
+      return rate > 0;
+   }
+
+   /**
+    Use to query if something may be sent now.
+    @param now The current time.
+    @return Returns true if the bucket is not in debt.
+    */
+   bool TokenBucket::isAvailable(std::chrono::steady_clock::time_point now) {
+      if (rate <= 0) {
+         return true;
+      }
+      refill(now);
+      return tokens >= 0;
+   }
+
+   /**
+    Takes tokens for something sent. The bucket goes into debt if it does not have enough tokens.
+    @param units The units sent.
+    @param now The current time.
+    */
+   void TokenBucket::take(double units, std::chrono::steady_clock::time_point now) {
+      if (rate > 0) {
+         refill(now);
+         tokens -= units;
+      }
+   }
+
+   /**
+    Gets the time when the debt of the bucket has been paid and something may be sent again.
+    @return The time, in the past if something may be sent now.
+    */
+   std::chrono::steady_clock::time_point TokenBucket::availableAt() const {
+      if (rate <= 0 || tokens >= 0) {
+         return updated;
+      }
+      return updated + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(-tokens / rate));
+   }
+
+   /**
+    Adds the tokens accumulated since the previous update, up to the burst size.
+    @param now The current time.
+    */
+   void TokenBucket::refill(std::chrono::steady_clock::time_point now) {
+      if (now > updated) {
+         tokens = std::min(burst, tokens + rate * std::chrono::duration<double>(now - updated).count());
+         updated = now;
+      }
+   }
+
+   /**
+    Creates a limiter with no limits.
+    */
+   RateLimiter::RateLimiter()
+   : defaultLimit{0, 0}, lastReport(std::chrono::steady_clock::now()), sentSinceReport(false)
+   {
+   }
+
+   /**
+    Parses the limits, replacing the previous ones. See the class documentation for the syntax.
+    @param limitString The limits.
+    @throws std::runtime_error if a limit or an address cannot be parsed.
+    */
+   void RateLimiter::parse(const std::string & limitString) {
+      defaultLimit = Limit{0, 0};
+      limits.clear();
+      destinations.clear();
+      std::vector<std::string> limitStrings;
+      boost::split(limitStrings, limitString, boost::is_any_of(";"));
+      for (std::string & limitStr : limitStrings) {
+         boost::trim(limitStr);
+         if (limitStr.empty()) {
+            continue;
+         }
+         std::size_t equals = limitStr.find('=');
+         if (equals == std::string::npos) {
+            defaultLimit = parseLimit(limitStr);
+            continue;
+         }
+         std::string address = boost::trim_copy(limitStr.substr(0, equals));
+         std::vector<std::string> strs;
+         boost::split(strs, address, boost::is_any_of(":"));
+         if (strs.size() != 2) {
+            throw std::runtime_error("Invalid address in rate limit: " + address);
+         }
+         boost::asio::ip::udp::endpoint target(boost::asio::ip::address::from_string(strs.at(0)), std::stoi(strs.at(1)));
+         limits[target] = parseLimit(limitStr.substr(equals + 1));
+      }
+      LOG(INFO) << TAG << "Default limit " << defaultLimit.packages << " packages/s, " << defaultLimit.bytes << " bytes/s, and " << limits.size() << " destination specific limits.";
+   }
+
+   /**
+    Parses one limit, packages per second and bytes per second separated by a comma.
+    @param limit The limit string.
+    @return The limit.
+    @throws std::runtime_error if the limit cannot be parsed.
+    */
+   RateLimiter::Limit RateLimiter::parseLimit(const std::string & limit) {
+      std::vector<std::string> values;
+      boost::split(values, limit, boost::is_any_of(","));
+      if (values.size() != 2) {
+         throw std::runtime_error("Rate limit must be packages/s,bytes/s: " + limit);
+      }
+      Limit result{std::stod(boost::trim_copy(values.at(0))), std::stod(boost::trim_copy(values.at(1)))};
+      if (result.packages < 0 || result.bytes < 0) {
+         throw std::runtime_error("Negative rate limit: " + limit);
+      }
+      return result;
+   }
+
+   /**
+    Use to query if there are any limits.
+    @return Returns true if no destination is limited.
+    */
+   bool RateLimiter::isEmpty() const {
+      return defaultLimit.packages <= 0 && defaultLimit.bytes <= 0 && limits.empty();
+   }
+
+   /**
+    Use to query if a package may be sent to a destination now.
+    @param target The destination.
+    @param now The current time.
+    @return Returns true if the package may be sent.
+    */
+   bool RateLimiter::isAvailable(const boost::asio::ip::udp::endpoint & target, std::chrono::steady_clock::time_point now) {
+      Destination * destination = destinationOf(target, now);
+      return !destination || (destination->packages.isAvailable(now) && destination->bytes.isAvailable(now));
+   }
+
+   /**
+    Takes the tokens of a package sent to a destination.
+    @param target The destination.
+    @param bytes The size of the package.
+    @param now The current time.
+    */
+   void RateLimiter::take(const boost::asio::ip::udp::endpoint & target, std::size_t bytes, std::chrono::steady_clock::time_point now) {
+      Destination * destination = destinationOf(target, now);
+      if (destination) {
+         destination->packages.take(1, now);
+         destination->bytes.take(static_cast<double>(bytes), now);
+         destination->sentPackages++;
+         destination->sentBytes += bytes;
+         sentSinceReport = true;
+      }
+   }
+
+   /**
+    Gets the time when a package may be sent to a destination.
+    @param target The destination.
+    @return The time, in the past if a package may be sent now.
+    */
+   std::chrono::steady_clock::time_point RateLimiter::availableAt(const boost::asio::ip::udp::endpoint & target) {
+      auto found = destinations.find(target);
+      if (found == destinations.end()) {
+         return std::chrono::steady_clock::time_point::min();
+      }
+      return std::max(found->second.packages.availableAt(), found->second.bytes.availableAt());
+   }
+
+   /**
+    Gets the time when the rates should be reported next.
+    @return The time, or the maximum time point if nothing has been sent since the previous report.
+    */
+   std::chrono::steady_clock::time_point RateLimiter::nextReport() const {
+      if (!sentSinceReport) {
+         return std::chrono::steady_clock::time_point::max();
+      }
+      return lastReport + REPORT_INTERVAL;
+   }
+
+   /**
+    Takes the rates measured to the limited destinations since the previous call.
+    @param now The current time.
+    @param rates The rates are appended to this vector.
+    */
+   void RateLimiter::takeRates(std::chrono::steady_clock::time_point now, std::vector<Rate> & rates) {
+      const double seconds = std::chrono::duration<double>(now - lastReport).count();
+      if (seconds <= 0) {
+         return;
+      }
+      for (auto & item : destinations) {
+         Destination & destination = item.second;
+         rates.push_back(Rate{item.first, destination.sentPackages / seconds, destination.sentBytes / seconds});
+         destination.sentPackages = 0;
+         destination.sentBytes = 0;
+      }
+      lastReport = now;
+      sentSinceReport = false;
+   }
+
+   /**
+    Gets the buckets of a destination, creating them when the first package is sent to it.
+    @param target The destination.
+    @param now The current time.
+    @return The buckets, or null if the destination is not limited.
+    */
+   RateLimiter::Destination * RateLimiter::destinationOf(const boost::asio::ip::udp::endpoint & target, std::chrono::steady_clock::time_point now) {
+      auto found = destinations.find(target);
+      if (found != destinations.end()) {
+         return &found->second;
+      }
+      auto limit = limits.find(target);
+      const Limit & l = (limit != limits.end()) ? limit->second : defaultLimit;
+      if (l.packages <= 0 && l.bytes <= 0) {
+         return nullptr;
+      }
+      Destination destination{TokenBucket(l.packages, now), TokenBucket(l.bytes, now), 0, 0};
+      return &destinations.emplace(target, destination).first->second;
+   }
+
+} //namespace
@@ -0,0 +1,85 @@
+//
+//  RetransmissionTimer.cpp
+//  ProcessorNode
+//
+
+#include <algorithm>
+
+#include <ProcessorNode/RetransmissionTimer.h>
+
+namespace OHARBase {
+
+   /** Timeout before the first round trip has been measured. */
+   static const std::chrono::steady_clock::duration INITIAL_TIMEOUT{std::chrono::seconds(1)};
+   /** The shortest timeout. The next node delays the acks by up to 10 ms to coalesce them, so they may be late by that much. */
+   static const std::chrono::steady_clock::duration MIN_TIMEOUT{std::chrono::milliseconds(20)};
+   /** The longest timeout, also with the backoff. */
+   static const std::chrono::steady_clock::duration MAX_TIMEOUT{std::chrono::seconds(60)};
+   /** Resolution of the resend timers. */
+   static const std::chrono::steady_clock::duration GRANULARITY{std::chrono::milliseconds(10)};
+
+   /**
+    Creates the timer with no samples and the initial timeout of one second.
+    */
+   RetransmissionTimer::RetransmissionTimer()
+   : sampled(false), srtt(0), rttvar(0), rto(INITIAL_TIMEOUT)
+   {
+   }
+
+   /**
+    Updates the estimate with a measured round trip.
+    @param roundTrip The time from sending a package to receiving its ack.
+    */
+   void RetransmissionTimer::addSample(std::chrono::steady_clock::duration roundTrip) {
+      if (!sampled) {
+         srtt = roundTrip;
+         rttvar = roundTrip / 2;
+         sampled = true;
+      } else {
+         const std::chrono::steady_clock::duration error = srtt > roundTrip ? srtt - roundTrip : roundTrip - srtt;
+         // RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, SRTT = 7/8 SRTT + 1/8 R
+         rttvar = (rttvar * 3 + error) / 4;
+         srtt = (srtt * 7 + roundTrip) / 8;
+      }
+      rto = std::min(MAX_TIMEOUT, std::max(MIN_TIMEOUT, srtt + std::max(GRANULARITY, rttvar * 4)));
+   }
+
+   /**
+    Gets the time to wait for the ack of a package before resending it.
+    @param attempt How many times the package has been sent, including this time. The timeout
+    is doubled for each earlier attempt.
+    @return The timeout.
+    */
+   std::chrono::steady_clock::duration RetransmissionTimer::timeout(int attempt) const {
+      std::chrono::steady_clock::duration result = rto;
+      for (int backoff = 1; backoff < attempt && result < MAX_TIMEOUT; backoff++) {
+         result *= 2;
+      }
+      return std::min(result, MAX_TIMEOUT);
+   }
+
+   /**
+    Use to query if any round trips have been measured.
+    @return Returns true if the estimate is based on samples.
+    */
+   bool RetransmissionTimer::hasSamples() const {
+      return sampled;
+   }
+
+   /**
+    Gets the smoothed round trip time.
+    @return The estimate, zero if there are no samples.
+    */
+   std::chrono::steady_clock::duration RetransmissionTimer::smoothedRoundTrip() const {
+      return srtt;
+   }
+
+   /**
+    Gets the variation of the round trip time.
+    @return The variation, zero if there are no samples.
+    */
+   std::chrono::steady_clock::duration RetransmissionTimer::roundTripVariation() const {
+      return rttvar;
+   }
+
+} //namespace
@@ -0,0 +1,141 @@
+//
+//  SharedMemoryConnection.cpp
+//  ProcessorNode
+//
+
+#include <g3log/g3log.hpp>
+
+#include <ProcessorNode/SharedMemoryConnection.h>
+
+namespace OHARBase {
+
+   const std::string SharedMemoryConnection::TAG{"ShmConnection "};
+   /** How often opening the ring is tried when the receiving node is not running. */
+   static const std::chrono::milliseconds RETRY_INTERVAL{100};
+   /** How many packages are kept while the ring is not open. Older packages are dropped. */
+   static const std::size_t MAX_PENDING_FRAMES{4096};
+
+   /**
+    Creates the connection object. The ring is opened when the first packages are sent.
+    @param ringName The name of the ring, the shm:// address without the scheme.
+    */
+   SharedMemoryConnection::SharedMemoryConnection(const std::string & ringName)
+   : address("shm://" + ringName), name(ringName), nextAttempt(std::chrono::steady_clock::now()), interrupted(false)
+   {
+   }
+
+   SharedMemoryConnection::~SharedMemoryConnection() {
+   }
+
+   /**
+    Gets the address of the receiver.
+    @return The address in shm://name format.
+    */
+   const std::string & SharedMemoryConnection::getAddress() const {
+      return address;
+   }
+
+   /**
+    Writes the package to the ring if it is open, otherwise keeps it for the next flush.
+    @param data The serialized package.
+    */
+   void SharedMemoryConnection::queue(const std::string & data) {
+      if (ring && frames.empty()) {
+         if (data.length() > ring->maxRecordSize()) {
+            LOG(WARNING) << TAG << "Package of " << data.length() << " bytes does not fit into ring " << address << ", not sent.";
+            return;
+         }
+         if (ring->write(data.data(), data.length(), interrupted)) {
+            return;
+         }
+         closed();
+      }
+      if (frames.size() >= MAX_PENDING_FRAMES) {
+         LOG(WARNING) << TAG << "Too many packages waiting for ring " << address << ", dropping the oldest.";
+         frames.pop_front();
+      }
+      frames.push_back(data);
+   }
+
+   /**
+    Writes the packages kept while the ring was not open, and wakes up the receiver.
+    */
+   void SharedMemoryConnection::flush() {
+      if (!ring && (frames.empty() || !open())) {
+         return;
+      }
+      while (!frames.empty()) {
+         const std::string & frame = frames.front();
+         if (frame.length() > ring->maxRecordSize()) {
+            LOG(WARNING) << TAG << "Package of " << frame.length() << " bytes does not fit into ring " << address << ", not sent.";
+         } else if (!ring->write(frame.data(), frame.length(), interrupted)) {
+            closed();
+            return;
+         }
+         frames.pop_front();
+      }
+      ring->notifyConsumer();
+   }
+
+   /**
+    Stops waiting for space in the ring, from another thread.
+    */
+   void SharedMemoryConnection::interrupt() {
+      interrupted = true;
+   }
+
+   /**
+    Use to query if there are packages waiting for the ring to be opened.
+    @return Returns true if packages are waiting.
+    */
+   bool SharedMemoryConnection::hasPendingFrames() const {
+      return !frames.empty();
+   }
+
+   /**
+    Use to query if the connection is full. Never, since writing to the ring waits for space, and the
+    packages kept while the ring is not open are limited by dropping the oldest.
+    @return Returns false.
+    */
+   bool SharedMemoryConnection::isFull() const {
+      return false;
+   }
+
+   /**
+    Gets the time when opening the ring is tried again, if it is not open.
+    @return The time of the next attempt.
+    */
+   std::chrono::steady_clock::time_point SharedMemoryConnection::nextConnectAttempt() const {
+      return nextAttempt;
+   }
+
+   /**
+    Opens the ring created by the receiving node, if the retry interval has passed.
+    @return Returns true if the ring is open.
+    */
+   bool SharedMemoryConnection::open() {
+      if (interrupted || std::chrono::steady_clock::now() < nextAttempt) {
+         return false;
+      }
+      try {
+         ring.reset(new SharedMemoryRing(name, SharedMemoryRing::Producer));
+         LOG(INFO) << TAG << "Sending to " << address;
+         return true;
+      } catch (const std::exception & e) {
+         LOG(WARNING) << TAG << e.what() << ", retrying in " << RETRY_INTERVAL.count() << " ms";
+         nextAttempt = std::chrono::steady_clock::now() + RETRY_INTERVAL;
+      }
+      return false;
+   }
+
+   /**
+    Handles a ring closed by the receiver, or writing interrupted, by closing the ring.
+    The ring is opened again when the receiving node creates it again.
+    */
+   void SharedMemoryConnection::closed() {
+      LOG(WARNING) << TAG << "Ring " << address << " was closed by the receiver.";
+      ring.reset();
+      nextAttempt = std::chrono::steady_clock::now() + RETRY_INTERVAL;
+   }
+
+} //namespace
@@ -0,0 +1,335 @@
+//
+//  SharedMemoryRing.cpp
+//  ProcessorNode
+//
+
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#include <g3log/g3log.hpp>
+
+#include <ProcessorNode/SharedMemoryRing.h>
+
+namespace OHARBase {
+
+   const std::string SharedMemoryRing::TAG{"ShmRing "};
+
+#if defined(__linux__)
+
+   /** Identifies an initialized ring. */
+   static const std::uint32_t RING_MAGIC{0x4F484152};
+   /** Version of the ring layout. */
+   static const std::uint32_t RING_VERSION{1};
+   /** Length of a record telling that the rest of the ring is skipped and records continue from the start. */
+   static const std::uint32_t WRAP_MARKER{0xFFFFFFFF};
+   /** How long a producer waits for space at a time before checking if it was interrupted. */
+   static const std::chrono::milliseconds SPACE_WAIT_TIMEOUT{100};
+
+   /**
+    The header of the ring in shared memory. Producer and consumer positions are on separate
+    cache lines. Positions grow without wrapping; the offset in the ring is position modulo capacity.
+    */
+   struct SharedMemoryRing::Header {
+      /** RING_MAGIC when the ring has been initialized. */
+      std::atomic<std::uint32_t> magic;
+      /** RING_VERSION. */
+      std::uint32_t version;
+      /** Size of the ring data area. */
+      std::uint64_t capacity;
+      /** Set by the consumer when it goes away. */
+      std::atomic<std::uint32_t> closed;
+      /** Write position, updated by the producer. */
+      alignas(64) std::atomic<std::uint64_t> head;
+      /** Futex word the consumer waits on, changed when the consumer is woken up. */
+      std::atomic<std::uint32_t> headSequence;
+      /** Non-zero when the consumer is waiting for records. */
+      std::atomic<std::uint32_t> consumerWaiting;
+      /** Read position, updated by the consumer. */
+      alignas(64) std::atomic<std::uint64_t> tail;
+      /** Futex word the producer waits on, changed when the producer is woken up. */
+      std::atomic<std::uint32_t> tailSequence;
+      /** Non-zero when the producer is waiting for space. */
+      std::atomic<std::uint32_t> producerWaiting;
+   };
+
+   static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "Shared memory ring needs lock free 64 bit atomics");
+   static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t), "Futex words must be 32 bits");
+
+   /** Waits on a futex word shared between processes, until woken up, the word no longer has the expected value or the timeout passes. */
+   static void futexWait(std::atomic<std::uint32_t> & word, std::uint32_t expected, std::chrono::milliseconds timeout) {
+      struct timespec time;
+      time.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+      time.tv_nsec = static_cast<long>((timeout.count() % 1000) * 1000000);
+      ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT, expected, &time, nullptr, 0);
+   }
+
+   /** Changes the futex word and wakes up the processes waiting on it. */
+   static void futexWake(std::atomic<std::uint32_t> & word) {
+      word.fetch_add(1);
+      ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+   }
+
+   /** Rounds the record length up so that the records stay 8 byte aligned. */
+   static std::size_t recordSpace(std::size_t length) {
+      return (sizeof(std::uint32_t) + length + 7) & ~static_cast<std::size_t>(7);
+   }
+
+   /**
+    Creates (consumer) or opens (producer) the ring.
+    @param name The name of the ring, from the shm:// address. Letters, digits, - and _ are allowed.
+    @param r Whether this is the consumer or the producer of the ring.
+    @param size Size of the ring data area for the consumer, rounded up to a power of two. The producer uses the size of the existing ring.
+    @throws std::runtime_error if the ring cannot be created or opened.
+    */
+   SharedMemoryRing::SharedMemoryRing(const std::string & name, Role r, std::size_t size)
+   : role(r), mappedSize(0), header(nullptr), ring(nullptr), capacity(0), peekedTail(0)
+   {
+      if (name.empty() || name.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_") != std::string::npos) {
+         throw std::runtime_error("Invalid shared memory ring name: " + name);
+      }
+      path = "/ohar-" + name;
+      int fd = -1;
+      if (role == Consumer) {
+         capacity = 4096;
+         while (capacity < size) {
+            capacity *= 2;
+         }
+         mappedSize = sizeof(Header) + capacity;
+         // A ring left behind by a consumer which did not exit cleanly is replaced.
+         ::shm_unlink(path.c_str());
+         fd = ::shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+         if (fd < 0 || ::ftruncate(fd, static_cast<off_t>(mappedSize)) != 0) {
+            if (fd >= 0) ::close(fd);
+            throw std::runtime_error("Cannot create shared memory ring " + path + ": " + std::strerror(errno));
+         }
+      } else {
+         fd = ::shm_open(path.c_str(), O_RDWR, 0600);
+         struct stat info;
+         if (fd < 0 || ::fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) <= sizeof(Header)) {
+            if (fd >= 0) ::close(fd);
+            throw std::runtime_error("Cannot open shared memory ring " + path);
+         }
+         mappedSize = static_cast<std::size_t>(info.st_size);
+      }
+      void * mapping = ::mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      ::close(fd);
+      if (mapping == MAP_FAILED) {
+         throw std::runtime_error("Cannot map shared memory ring " + path + ": " + std::strerror(errno));
+      }
+      ring = static_cast<char*>(mapping) + sizeof(Header);
+      if (role == Consumer) {
+         header = new (mapping) Header();
+         header->version = RING_VERSION;
+         header->capacity = capacity;
+         header->magic.store(RING_MAGIC, std::memory_order_release);
+         LOG(INFO) << TAG << "Created ring " << path << " of " << capacity << " bytes";
+      } else {
+         header = static_cast<Header*>(mapping);
+         capacity = static_cast<std::size_t>(header->capacity);
+         if (header->magic.load(std::memory_order_acquire) != RING_MAGIC || header->version != RING_VERSION
+             || sizeof(Header) + capacity != mappedSize || header->closed.load()) {
+            ::munmap(mapping, mappedSize);
+            throw std::runtime_error("Shared memory ring " + path + " is not ready");
+         }
+         LOG(INFO) << TAG << "Opened ring " << path << " of " << capacity << " bytes";
+      }
+   }
+
+   /**
+    Unmaps the ring. The consumer also marks the ring closed, so that the producer notices it, and removes it.
+    */
+   SharedMemoryRing::~SharedMemoryRing() {
+      if (role == Consumer) {
+         header->closed.store(1);
+         futexWake(header->tailSequence);
+         ::shm_unlink(path.c_str());
+      }
+      ::munmap(header, mappedSize);
+   }
+
+   /**
+    Writes a record to the ring, waiting for the consumer to make space if the ring is full.
+    The consumer is not woken up for each record; call notifyConsumer() after writing a batch.
+    @param data The record bytes.
+    @param length Length of the record, at most maxRecordSize().
+    @param interrupted Set by another thread to stop waiting for space.
+    @return Returns false if the record was not written, because the ring was closed or the writing was interrupted.
+    */
+   bool SharedMemoryRing::write(const char * data, std::size_t length, const std::atomic<bool> & interrupted) {
+      if (length > maxRecordSize()) {
+         return false;
+      }
+      const std::uint64_t position = header->head.load(std::memory_order_relaxed);
+      const std::size_t offset = static_cast<std::size_t>(position & (capacity - 1));
+      const std::size_t toEnd = capacity - offset;
+      const std::size_t space = recordSpace(length);
+      const std::size_t needed = (space > toEnd) ? toEnd + space : space;
+      std::uint64_t tail = header->tail.load(std::memory_order_acquire);
+      while (capacity - (position - tail) < needed) {
+         if (interrupted || header->closed.load()) {
+            return false;
+         }
+         std::uint32_t sequence = header->tailSequence.load();
+         header->producerWaiting.store(1);
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+         tail = header->tail.load(std::memory_order_acquire);
+         if (capacity - (position - tail) < needed) {
+            // Make sure the consumer is not sleeping while the producer waits for it.
+            notifyConsumer();
+            futexWait(header->tailSequence, sequence, SPACE_WAIT_TIMEOUT);
+            tail = header->tail.load(std::memory_order_acquire);
+         }
+         header->producerWaiting.store(0);
+      }
+      std::uint64_t next = position;
+      std::size_t writeOffset = offset;
+      if (space > toEnd) {
+         std::uint32_t marker = WRAP_MARKER;
+         std::memcpy(ring + offset, &marker, sizeof(marker));
+         next += toEnd;
+         writeOffset = 0;
+      }
+      std::uint32_t recordLength = static_cast<std::uint32_t>(length);
+      std::memcpy(ring + writeOffset, &recordLength, sizeof(recordLength));
+      std::memcpy(ring + writeOffset + sizeof(recordLength), data, length);
+      header->head.store(next + space, std::memory_order_release);
+      return true;
+   }
+
+   /**
+    Wakes up the consumer if it is waiting for records.
+    */
+   void SharedMemoryRing::notifyConsumer() {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (header->consumerWaiting.load()) {
+         futexWake(header->headSequence);
+      }
+   }
+
+   /**
+    Use to query if the consumer has closed the ring.
+    @return Returns true if the ring is closed.
+    */
+   bool SharedMemoryRing::isClosed() const {
+      return header->closed.load() != 0;
+   }
+
+   /**
+    Gets the maximum length of a record.
+    @return The maximum record length in bytes.
+    */
+   std::size_t SharedMemoryRing::maxRecordSize() const {
+      return capacity / 2 - sizeof(std::uint32_t);
+   }
+
+   /**
+    Waits until there are records to read in the ring.
+    @param timeout How long to wait at most.
+    @return Returns true if there are records to read.
+    */
+   bool SharedMemoryRing::waitForRecords(std::chrono::milliseconds timeout) {
+      const std::uint64_t tail = header->tail.load(std::memory_order_relaxed);
+      if (header->head.load(std::memory_order_acquire) != tail) {
+         return true;
+      }
+      std::uint32_t sequence = header->headSequence.load();
+      header->consumerWaiting.store(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (header->head.load(std::memory_order_acquire) == tail) {
+         futexWait(header->headSequence, sequence, timeout);
+      }
+      header->consumerWaiting.store(0);
+      return header->head.load(std::memory_order_acquire) != tail;
+   }
+
+   /**
+    Gets the records written to the ring. The records point to the shared memory and stay valid
+    until consume() is called.
+    @param records The records are appended to this container.
+    @return The number of records appended.
+    */
+   std::size_t SharedMemoryRing::peek(std::vector<Record> & records) {
+      std::size_t count = 0;
+      std::uint64_t position = header->tail.load(std::memory_order_relaxed);
+      const std::uint64_t head = header->head.load(std::memory_order_acquire);
+      while (position < head) {
+         const std::size_t offset = static_cast<std::size_t>(position & (capacity - 1));
+         std::uint32_t length;
+         std::memcpy(&length, ring + offset, sizeof(length));
+         if (length == WRAP_MARKER) {
+            position += capacity - offset;
+            continue;
+         }
+         records.push_back(Record{ring + offset + sizeof(length), length});
+         position += recordSpace(length);
+         count++;
+      }
+      peekedTail = position;
+      return count;
+   }
+
+   /**
+    Releases the records returned by peek() so that the producer can reuse the space,
+    and wakes up the producer if it is waiting for space.
+    */
+   void SharedMemoryRing::consume() {
+      header->tail.store(peekedTail, std::memory_order_release);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (header->producerWaiting.load()) {
+         futexWake(header->tailSequence);
+      }
+   }
+
+#else
+
+   struct SharedMemoryRing::Header {
+   };
+
+   SharedMemoryRing::SharedMemoryRing(const std::string & name, Role r, std::size_t size)
+   : role(r), mappedSize(0), header(nullptr), ring(nullptr), capacity(0), peekedTail(0)
+   {
+      throw std::runtime_error("Shared memory transport is supported only in Linux");
+   }
+
+   SharedMemoryRing::~SharedMemoryRing() {
+   }
+
+   bool SharedMemoryRing::write(const char * data, std::size_t length, const std::atomic<bool> & interrupted) {
+      return false;
+   }
+
+   void SharedMemoryRing::notifyConsumer() {
+   }
+
+   bool SharedMemoryRing::isClosed() const {
+      return true;
+   }
+
+   std::size_t SharedMemoryRing::maxRecordSize() const {
+      return 0;
+   }
+
+   bool SharedMemoryRing::waitForRecords(std::chrono::milliseconds timeout) {
+      return false;
+   }
+
+   std::size_t SharedMemoryRing::peek(std::vector<Record> & records) {
+      return 0;
+   }
+
+   void SharedMemoryRing::consume() {
+   }
+
+#endif
+
+} //namespace
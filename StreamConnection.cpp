@@ -0,0 +1,291 @@
+//
+//  StreamConnection.cpp
+//  ProcessorNode
+//
+
+#include <g3log/g3log.hpp>
+
+#include <ProcessorNode/StreamConnection.h>
+
+namespace OHARBase {
+
+   const std::string StreamConnection::TAG{"Stream "};
+   /** How long connecting to the receiver may take. */
+   static const std::chrono::seconds CONNECT_TIMEOUT{3};
+   /** Backoff after the first failed connection attempt. */
+   static const std::chrono::milliseconds MIN_BACKOFF{100};
+   /** Maximum backoff between connection attempts. */
+   static const std::chrono::milliseconds MAX_BACKOFF{10000};
+   /** How many frames may wait to be written. More are kept while the connection is down by dropping the oldest. */
+   static const std::size_t MAX_PENDING_FRAMES{4096};
+   /** How many bytes of frames may wait to be written before the connection is full. */
+   static const std::size_t MAX_PENDING_BYTES{64 * 1024 * 1024};
+
+   /**
+    Creates the connection object and starts its thread. The connection is opened when the first frames are flushed.
+    @param hostName The numeric IP address of the receiver.
+    @param portNumber The port the receiver listens to.
+    @param drained Called from the thread of the connection when the connection is no longer full.
+    */
+   StreamConnection::StreamConnection(const std::string & hostName, int portNumber, std::function<void()> drained)
+   : endpoint(boost::asio::ip::address::from_string(hostName), static_cast<unsigned short>(portNumber)),
+     work(boost::asio::make_work_guard(context)), socket(context), connectTimer(context), retryTimer(context),
+     connected(false), connecting(false), retrying(false), writing(false), stopped(false), pendingFrames(0), pendingBytes(0),
+     backoff(MIN_BACKOFF), drained(std::move(drained))
+   {
+      address = hostName + ":" + std::to_string(portNumber);
+      thread = std::thread([this] { context.run(); });
+   }
+
+   StreamConnection::~StreamConnection() {
+      close();
+   }
+
+   /**
+    Gets the address of the receiver.
+    @return The address in host:port format.
+    */
+   const std::string & StreamConnection::getAddress() const {
+      return address;
+   }
+
+   /**
+    Queues a serialized package to be sent in the next flush.
+    @param data The serialized package.
+    */
+   void StreamConnection::queue(const std::string & data) {
+      const std::uint32_t length = static_cast<std::uint32_t>(data.length());
+      std::string frame;
+      frame.reserve(4 + data.length());
+      frame.push_back(static_cast<char>((length >> 24) & 0xFF));
+      frame.push_back(static_cast<char>((length >> 16) & 0xFF));
+      frame.push_back(static_cast<char>((length >> 8) & 0xFF));
+      frame.push_back(static_cast<char>(length & 0xFF));
+      frame.append(data);
+      batch.push_back(std::move(frame));
+   }
+
+   /**
+    Hands the queued frames to the thread of the connection, which writes them to the receiver, opening
+    the connection first if it is not open and the backoff time has passed. Does not wait for the writing.
+    */
+   void StreamConnection::flush() {
+      if (batch.empty()) {
+         return;
+      }
+      std::size_t bytes = 0;
+      for (const std::string & frame : batch) {
+         bytes += frame.length();
+      }
+      pendingFrames += batch.size();
+      pendingBytes += bytes;
+      boost::asio::post(context, [this, newFrames = std::move(batch)]() mutable {
+         enqueue(std::move(newFrames));
+      });
+      batch.clear();
+   }
+
+   /**
+    Stops opening the connection and writing to it, when the writer is stopped. The socket is closed
+    by the thread of the connection, so a connect or a write in progress is aborted there.
+    */
+   void StreamConnection::interrupt() {
+      boost::asio::post(context, [this] {
+         stopped = true;
+         connectTimer.cancel();
+         retryTimer.cancel();
+         boost::system::error_code ec;
+         socket.close(ec);
+         connected = false;
+      });
+   }
+
+   /**
+    Closes the connection and stops its thread. Frames not yet written are dropped.
+    */
+   void StreamConnection::close() {
+      work.reset();
+      context.stop();
+      if (thread.joinable()) {
+         thread.join();
+      }
+      boost::system::error_code ec;
+      socket.close(ec);
+      connected = false;
+      batch.clear();
+      frames.clear();
+      pendingFrames = 0;
+      pendingBytes = 0;
+   }
+
+   /**
+    Use to query if there are frames queued and not yet flushed. The frames flushed are written
+    by the thread of the connection, which opens the connection again by itself.
+    @return Returns true if there are frames waiting for the flush.
+    */
+   bool StreamConnection::hasPendingFrames() const {
+      return !batch.empty();
+   }
+
+   /**
+    Use to query if as many frames wait to be written as the connection may hold.
+    @return Returns true if the connection is full.
+    */
+   bool StreamConnection::isFull() const {
+      return pendingFrames >= MAX_PENDING_FRAMES || pendingBytes >= MAX_PENDING_BYTES;
+   }
+
+   /**
+    Use to query if the connection is open.
+    @return Returns true if connected to the receiver.
+    */
+   bool StreamConnection::isConnected() const {
+      return connected;
+   }
+
+   /**
+    Gets the time when the writer should flush again to get the connection opened. Never, since the
+    thread of the connection opens it again by itself.
+    @return The maximum time point.
+    */
+   std::chrono::steady_clock::time_point StreamConnection::nextConnectAttempt() const {
+      return std::chrono::steady_clock::time_point::max();
+   }
+
+   /**
+    Adds the frames flushed by the writer to the frames waiting, and writes them or opens the connection.
+    Called in the thread of the connection.
+    @param newFrames The frames flushed.
+    */
+   void StreamConnection::enqueue(std::vector<std::string> && newFrames) {
+      for (std::string & frame : newFrames) {
+         frames.push_back(std::move(frame));
+      }
+      if (connected) {
+         write();
+         return;
+      }
+      if (frames.size() > MAX_PENDING_FRAMES) {
+         LOG(WARNING) << TAG << "Too many packages waiting for connection to " << address << ", dropping the oldest.";
+         std::size_t count = 0;
+         std::size_t bytes = 0;
+         while (frames.size() > MAX_PENDING_FRAMES) {
+            count++;
+            bytes += frames.front().length();
+            frames.pop_front();
+         }
+         written(count, bytes);
+      }
+      if (!connecting && !retrying && !stopped) {
+         connect();
+      }
+   }
+
+   /**
+    Starts opening the connection, timed out so that an unreachable receiver is tried again later.
+    Called in the thread of the connection.
+    */
+   void StreamConnection::connect() {
+      connecting = true;
+      socket.async_connect(endpoint, [this](const boost::system::error_code & error) {
+         connecting = false;
+         connectTimer.cancel();
+         if (error) {
+            disconnected(error == boost::asio::error::operation_aborted ? boost::asio::error::timed_out : error);
+            return;
+         }
+         boost::system::error_code ec;
+         socket.set_option(boost::asio::ip::tcp::no_delay(true), ec);
+         connected = true;
+         backoff = MIN_BACKOFF;
+         LOG(INFO) << TAG << "Connected to " << address;
+         write();
+      });
+      connectTimer.expires_after(CONNECT_TIMEOUT);
+      connectTimer.async_wait([this](const boost::system::error_code & error) {
+         if (!error && connecting) {
+            // Closing aborts the connect.
+            boost::system::error_code ec;
+            socket.close(ec);
+         }
+      });
+   }
+
+   /**
+    Writes the frames waiting with one gathering write, unless a write is already in progress.
+    Frames added meanwhile are written when it completes. Called in the thread of the connection.
+    */
+   void StreamConnection::write() {
+      if (writing || !connected || frames.empty()) {
+         return;
+      }
+      writing = true;
+      buffers.clear();
+      buffers.reserve(frames.size());
+      // Adding frames to the end of the deque does not move the frames being written.
+      for (const std::string & frame : frames) {
+         buffers.push_back(boost::asio::buffer(frame));
+      }
+      boost::asio::async_write(socket, buffers, [this](const boost::system::error_code & error, std::size_t bytesWritten) {
+         writing = false;
+         // Drop the frames written completely. A partially written frame is written again
+         // from the beginning over the next connection.
+         std::size_t count = 0;
+         std::size_t bytes = 0;
+         while (!frames.empty() && bytesWritten >= frames.front().length()) {
+            bytesWritten -= frames.front().length();
+            bytes += frames.front().length();
+            count++;
+            frames.pop_front();
+         }
+         written(count, bytes);
+         if (error) {
+            disconnected(error);
+         } else {
+            write();
+         }
+      });
+   }
+
+   /**
+    Counts frames written or dropped, and tells the writer if the connection is no longer full.
+    @param count The number of frames.
+    @param bytes The bytes of the frames.
+    */
+   void StreamConnection::written(std::size_t count, std::size_t bytes) {
+      if (count == 0) {
+         return;
+      }
+      const bool wasFull = isFull();
+      pendingFrames -= count;
+      pendingBytes -= bytes;
+      if (wasFull && !isFull() && drained) {
+         drained();
+      }
+   }
+
+   /**
+    Handles a failed connection attempt or a broken connection by closing the socket and
+    scheduling the next connection attempt. Called in the thread of the connection.
+    @param error The reason for the failure.
+    */
+   void StreamConnection::disconnected(const boost::system::error_code & error) {
+      boost::system::error_code ec;
+      socket.close(ec);
+      connected = false;
+      if (stopped) {
+         return;
+      }
+      LOG(WARNING) << TAG << "Connection to " << address << " failed: " << error.message() << ", retrying in " << backoff.count() << " ms";
+      retrying = true;
+      retryTimer.expires_after(backoff);
+      retryTimer.async_wait([this](const boost::system::error_code & timerError) {
+         retrying = false;
+         if (!timerError && !stopped && !frames.empty()) {
+            connect();
+         }
+      });
+      backoff = std::min(backoff * 2, MAX_BACKOFF);
+   }
+
+} //namespace
@@ -0,0 +1,200 @@
+//
+//  StreamListener.cpp
+//  ProcessorNode
+//
+
+#include <g3log/g3log.hpp>
+
+#include <ProcessorNode/StreamListener.h>
+
+namespace OHARBase {
+
+   const std::string StreamListener::TAG{"Listener "};
+   /** How many bytes are read from a connection at most in one read. */
+   static const std::size_t READ_CHUNK_SIZE{65536};
+   /** Default maximum length of a frame. */
+   static const std::size_t DEFAULT_MAX_FRAME_SIZE{65536};
+
+   /**
+    A connection accepted by the listener. Reads the bytes from the connection and splits them into frames.
+    */
+   class StreamListener::Session : public std::enable_shared_from_this<StreamListener::Session> {
+   public:
+      Session(StreamListener & owner, boost::asio::ip::tcp::socket && s)
+      : listener(owner), socket(std::move(s)), chunk(READ_CHUNK_SIZE)
+      {
+         boost::system::error_code ec;
+         from = socket.remote_endpoint(ec);
+      }
+
+      /** Starts reading from the connection. */
+      void read() {
+         auto self = shared_from_this();
+         socket.async_read_some(boost::asio::buffer(chunk), [this, self](const boost::system::error_code & error, std::size_t bytes) {
+            handleRead(error, bytes);
+         });
+      }
+
+      /** Closes the connection. */
+      void close() {
+         boost::system::error_code ec;
+         socket.close(ec);
+      }
+
+   private:
+      /**
+       Appends the bytes read to the received bytes, and gives the complete frames to the listener's handler.
+       @param error Error code of the read.
+       @param bytes Number of bytes read.
+       */
+      void handleRead(const boost::system::error_code & error, std::size_t bytes) {
+         if (error) {
+            if (error != boost::asio::error::operation_aborted) {
+               LOG(INFO) << TAG << "Connection from " << from.address() << ":" << from.port() << " closed: " << error.message();
+               listener.remove(shared_from_this());
+            }
+            return;
+         }
+         received.append(chunk.data(), bytes);
+         std::vector<std::string> frames;
+         std::size_t offset = 0;
+         while (received.length() - offset >= 4) {
+            const unsigned char * header = reinterpret_cast<const unsigned char*>(received.data() + offset);
+            const std::size_t length = (static_cast<std::size_t>(header[0]) << 24) | (static_cast<std::size_t>(header[1]) << 16) |
+                                       (static_cast<std::size_t>(header[2]) << 8) | static_cast<std::size_t>(header[3]);
+            if (length > listener.maxFrameSize) {
+               LOG(WARNING) << TAG << "Frame of " << length << " bytes from " << from.address() << " exceeds the maximum, closing the connection.";
+               close();
+               listener.remove(shared_from_this());
+               return;
+            }
+            if (received.length() - offset - 4 < length) {
+               break;
+            }
+            frames.emplace_back(received, offset + 4, length);
+            offset += 4 + length;
+         }
+         received.erase(0, offset);
+         if (!frames.empty()) {
+            listener.handler(frames, from);
+         }
+         read();
+      }
+
+   private:
+      /** The listener owning the session. */
+      StreamListener & listener;
+      /** The connected socket. */
+      boost::asio::ip::tcp::socket socket;
+      /** The address of the sender. */
+      boost::asio::ip::tcp::endpoint from;
+      /** Buffer for reading from the socket. */
+      std::vector<char> chunk;
+      /** Bytes received but not yet handled as frames. */
+      std::string received;
+   };
+
+   /**
+    Creates the listener.
+    @param io_s The Boost asynchronous io service running the reads.
+    @param frameHandler The function handling the received frames.
+    */
+   StreamListener::StreamListener(boost::asio::io_service & io_s, FrameHandler frameHandler)
+   : acceptor(io_s), incoming(io_s), handler(frameHandler), maxFrameSize(DEFAULT_MAX_FRAME_SIZE)
+   {
+   }
+
+   StreamListener::~StreamListener() {
+      stop();
+   }
+
+   /**
+    Starts listening for connections.
+    @param port The port to listen to.
+    @throws std::runtime_error if the port cannot be listened to.
+    */
+   void StreamListener::start(int port) {
+      boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address_v4::any(), static_cast<unsigned short>(port));
+      boost::system::error_code ec;
+      acceptor.open(endpoint.protocol(), ec);
+      if (!ec) acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true), ec);
+      if (!ec) acceptor.bind(endpoint, ec);
+      if (!ec) acceptor.listen(boost::asio::socket_base::max_listen_connections, ec);
+      if (ec) {
+         throw std::runtime_error("Cannot listen to TCP port " + std::to_string(port) + ": " + ec.message());
+      }
+      LOG(INFO) << TAG << "Listening for connections in port " << port;
+      accept();
+   }
+
+   /**
+    Stops listening and closes the open connections.
+    */
+   void StreamListener::stop() {
+      boost::system::error_code ec;
+      acceptor.close(ec);
+      std::lock_guard<std::mutex> lock(guard);
+      for (const std::shared_ptr<Session> & session : sessions) {
+         session->close();
+      }
+      sessions.clear();
+   }
+
+   /**
+    Sets the maximum length of a frame. Connections sending longer frames are closed.
+    @param size The maximum frame size in bytes.
+    */
+   void StreamListener::setMaxFrameSize(std::size_t size) {
+      maxFrameSize = size;
+   }
+
+   /**
+    Gets the number of open connections.
+    @return Number of connections.
+    */
+   std::size_t StreamListener::connectionCount() {
+      std::lock_guard<std::mutex> lock(guard);
+      return sessions.size();
+   }
+
+   /**
+    Accepts the next connection asynchronously.
+    */
+   void StreamListener::accept() {
+      acceptor.async_accept(incoming, [this](const boost::system::error_code & error) {
+         handleAccept(error);
+      });
+   }
+
+   /**
+    Starts reading from an accepted connection and accepts the next one.
+    @param error Error code of the accept.
+    */
+   void StreamListener::handleAccept(const boost::system::error_code & error) {
+      if (error == boost::asio::error::operation_aborted || !acceptor.is_open()) {
+         return;
+      }
+      if (!error) {
+         std::shared_ptr<Session> session = std::make_shared<Session>(*this, std::move(incoming));
+         {
+            std::lock_guard<std::mutex> lock(guard);
+            sessions.insert(session);
+         }
+         LOG(INFO) << TAG << "Accepted a connection";
+         session->read();
+      } else {
+         LOG(WARNING) << TAG << "Accepting a connection failed: " << error.message();
+      }
+      accept();
+   }
+
+   /**
+    Removes a closed connection.
+    @param session The connection to remove.
+    */
+   void StreamListener::remove(const std::shared_ptr<Session> & session) {
+      std::lock_guard<std::mutex> lock(guard);
+      sessions.erase(session);
+   }
+
+} //namespace
@@ -0,0 +1,185 @@
+//
+//  TimerWheel.cpp
+//  ProcessorNode
+//
+
+#include <algorithm>
+
+#include <ProcessorNode/TimerWheel.h>
+
+namespace OHARBase {
+
+   /**
+    Creates an empty wheel.
+    @param tick The length of a tick, the resolution of the deadlines.
+    @param now The current time, tick zero of the wheel.
+    */
+   TimerWheel::TimerWheel(std::chrono::milliseconds tick, std::chrono::steady_clock::time_point now)
+   : tickLength(tick), origin(now), currentTick(0), count(0)
+   {
+   }
+
+   /**
+    Schedules a deadline. The same id may be scheduled several times.
+    @param id Identifies the deadline to the caller when it expires.
+    @param deadline When the deadline expires.
+    */
+   void TimerWheel::schedule(std::uint64_t id, std::chrono::steady_clock::time_point deadline) {
+      place(Timer{id, tickOf(deadline)});
+      count++;
+   }
+
+   /**
+    Advances the wheel to the current time and gives the ids of the expired deadlines.
+    @param now The current time.
+    @param expired The ids of the expired deadlines are appended to this vector.
+    */
+   void TimerWheel::advance(std::chrono::steady_clock::time_point now, std::vector<std::uint64_t> & expired) {
+      // Only the ticks which have fully passed are advanced over.
+      const std::uint64_t target = now > origin ? static_cast<std::uint64_t>((now - origin) / tickLength) : 0;
+      if (!due.empty()) {
+         expired.insert(expired.end(), due.begin(), due.end());
+         count -= due.size();
+         due.clear();
+      }
+      if (count == 0) {
+         currentTick = std::max(currentTick, target);
+         return;
+      }
+      std::vector<Timer> cascaded;
+      while (currentTick < target) {
+         currentTick++;
+         // When a level wraps around, the deadlines of the next slot of the level above are moved down.
+         for (int level = 1; level < Levels; level++) {
+            if ((currentTick & ((std::uint64_t(1) << (SlotBits * level)) - 1)) != 0) {
+               break;
+            }
+            std::vector<Timer> & slot = wheel[level][(currentTick >> (SlotBits * level)) & (Slots - 1)];
+            cascaded.swap(slot);
+            for (const Timer & timer : cascaded) {
+               place(timer);
+            }
+            cascaded.clear();
+         }
+         std::vector<Timer> & slot = wheel[0][currentTick & (Slots - 1)];
+         for (const Timer & timer : slot) {
+            expired.push_back(timer.id);
+         }
+         count -= slot.size();
+         slot.clear();
+         if (!due.empty()) {
+            expired.insert(expired.end(), due.begin(), due.end());
+            count -= due.size();
+            due.clear();
+         }
+         if (count == 0) {
+            currentTick = target;
+         }
+      }
+   }
+
+   /**
+    Gets the time the wheel should be advanced next. This may be earlier than the next deadline,
+    when the deadlines on the higher levels must be moved down.
+    @return The time, or the maximum time point if the wheel is empty.
+    */
+   std::chrono::steady_clock::time_point TimerWheel::nextDeadline() const {
+      if (count == 0) {
+         return std::chrono::steady_clock::time_point::max();
+      }
+      if (!due.empty()) {
+         return timeOf(currentTick);
+      }
+      std::uint64_t next = UINT64_MAX;
+      for (int level = 0; level < Levels; level++) {
+         const std::uint64_t base = currentTick >> (SlotBits * level);
+         for (std::uint64_t step = 1; step <= Slots; step++) {
+            if (!wheel[level][(base + step) & (Slots - 1)].empty()) {
+               next = std::min(next, (base + step) << (SlotBits * level));
+               break;
+            }
+         }
+      }
+      return timeOf(next);
+   }
+
+   /**
+    Gets the number of deadlines in the wheel.
+    @return The number of deadlines.
+    */
+   std::size_t TimerWheel::size() const {
+      return count;
+   }
+
+   /**
+    Use to query if the wheel has no deadlines.
+    @return Returns true if there are no deadlines.
+    */
+   bool TimerWheel::isEmpty() const {
+      return count == 0;
+   }
+
+   /**
+    Removes all the deadlines.
+    */
+   void TimerWheel::clear() {
+      for (auto & level : wheel) {
+         for (std::vector<Timer> & slot : level) {
+            slot.clear();
+         }
+      }
+      due.clear();
+      count = 0;
+   }
+
+   /**
+    Puts a deadline into the slot of the lowest level covering it. Deadlines further away
+    than the whole wheel covers are put into the last level, and moved there again later.
+    @param timer The deadline to place.
+    */
+   void TimerWheel::place(const Timer & timer) {
+      if (timer.tick <= currentTick) {
+         due.push_back(timer.id);
+         return;
+      }
+      const std::uint64_t delta = timer.tick - currentTick;
+      for (int level = 0; level < Levels; level++) {
+         if (delta < (std::uint64_t(1) << (SlotBits * (level + 1)))) {
+            wheel[level][(timer.tick >> (SlotBits * level)) & (Slots - 1)].push_back(timer);
+            return;
+         }
+      }
+      const int top = Levels - 1;
+      const std::uint64_t latest = currentTick + (std::uint64_t(1) << (SlotBits * Levels)) - 1;
+      wheel[top][(latest >> (SlotBits * top)) & (Slots - 1)].push_back(timer);
+   }
+
+   /**
+    Converts a time to ticks, rounding up so that deadlines never expire early.
+    @param time The time to convert.
+    @return The tick.
+    */
+   std::uint64_t TimerWheel::tickOf(std::chrono::steady_clock::time_point time) const {
+      if (time <= origin) {
+         return 0;
+      }
+      const std::chrono::steady_clock::duration elapsed = time - origin;
+      if (elapsed > std::chrono::steady_clock::duration::max() - tickLength) {
+         return UINT64_MAX;
+      }
+      return static_cast<std::uint64_t>((elapsed + tickLength - std::chrono::steady_clock::duration(1)) / tickLength);
+   }
+
+   /**
+    Converts ticks to time.
+    @param tick The tick to convert.
+    @return The time of the tick.
+    */
+   std::chrono::steady_clock::time_point TimerWheel::timeOf(std::uint64_t tick) const {
+      if (tick >= static_cast<std::uint64_t>((std::chrono::steady_clock::time_point::max() - origin) / tickLength)) {
+         return std::chrono::steady_clock::time_point::max();
+      }
+      return origin + tickLength * static_cast<std::chrono::steady_clock::rep>(tick);
+   }
+
+} //namespace
@@ -0,0 +1,93 @@
+//
+//  UuidGenerator.cpp
+//  ProcessorNode
+//
+
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+
+#include <boost/uuid/random_generator.hpp>
+
+#include <ProcessorNode/UuidGenerator.h>
+
+namespace OHARBase {
+
+   std::atomic<UuidGenerator::Version> UuidGenerator::version{UuidGenerator::Version::Random};
+
+   /** The generator of random uuids of the thread, seeded when first used in the thread. */
+   static thread_local boost::uuids::random_generator_mt19937 randomGenerator;
+
+   /**
+    Generates a new uuid of the configured version.
+    @return The uuid.
+    */
+   boost::uuids::uuid UuidGenerator::generate() {
+      if (version.load(std::memory_order_relaxed) == Version::TimeOrdered) {
+         return timeOrdered();
+      }
+      return randomGenerator();
+   }
+
+   /**
+    Sets the version of the uuids generated, for all the threads.
+    @param uuidVersion The version.
+    */
+   void UuidGenerator::setVersion(Version uuidVersion) {
+      version = uuidVersion;
+   }
+
+   /**
+    Gets the version of the uuids generated.
+    @return The version.
+    */
+   UuidGenerator::Version UuidGenerator::getVersion() {
+      return version;
+   }
+
+   /**
+    Gets the uuid version by its name in the node configuration.
+    @param name The name: 4 for random uuids, 7 for time-ordered uuids.
+    @return The version.
+    @throws std::runtime_error if the name is not a supported version.
+    */
+   UuidGenerator::Version UuidGenerator::versionFrom(const std::string & name) {
+      if (name == "4") {
+         return Version::Random;
+      } else if (name == "7") {
+         return Version::TimeOrdered;
+      }
+      throw std::runtime_error("Unsupported uuid version: " + name);
+   }
+
+   /**
+    Generates a time-ordered uuid: a random uuid with the time and the counter written over its first bits.
+    If the clock has not advanced since the previous uuid of the thread, the counter is incremented, and when
+    the counter runs out, the time is advanced by a millisecond, so the uuids of a thread are always in order.
+    @return The uuid.
+    */
+   boost::uuids::uuid UuidGenerator::timeOrdered() {
+      /** The time of the previous uuid of the thread. */
+      static thread_local std::uint64_t previousTime = 0;
+      /** The counter of the uuids of the thread within the time. */
+      static thread_local std::uint16_t counter = 0;
+      const std::uint64_t now = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+         std::chrono::system_clock::now().time_since_epoch()).count());
+      if (now > previousTime) {
+         previousTime = now;
+         counter = 0;
+      } else if (++counter > 0x0FFF) {
+         previousTime++;
+         counter = 0;
+      }
+      // The variant bits are already set in the random uuid.
+      boost::uuids::uuid id = randomGenerator();
+      for (int index = 0; index < 6; index++) {
+         id.data[index] = static_cast<std::uint8_t>(previousTime >> (8 * (5 - index)));
+      }
+      id.data[6] = static_cast<std::uint8_t>(0x70 | (counter >> 8));
+      id.data[7] = static_cast<std::uint8_t>(counter);
+      return id;
+   }
+
+} //namespace
@@ -0,0 +1,107 @@
+//
+//  AckCoalescer.h
+//  ProcessorNode
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <utility>
+#include <cstdint>
+#include <chrono>
+
+#include <boost/asio.hpp>
+
+#include <ProcessorNode/Package.h>
+
+namespace OHARBase {
+
+   /**
+    SequenceAck acknowledges the packages of one stream (from a sending node to this node) by their
+    sequence numbers: all the packages up to the cumulative sequence number, and the packages in the
+    ranges above it which arrived before the missing ones. It is the payload of an ack package.
+    */
+   struct SequenceAck {
+      /** The stream the acknowledged packages were sent in. */
+      std::uint32_t stream = 0;
+      /** All the packages with this or a smaller sequence number have arrived. */
+      std::uint64_t cumulative = 0;
+      /** Ranges of sequence numbers (first, last) above the cumulative number which have arrived. */
+      std::vector<std::pair<std::uint64_t, std::uint64_t>> ranges;
+      /** How many more packages the receiver can take from the sender, or -1 if the receiver does not limit it. */
+      std::int64_t credit = -1;
+
+      std::string toPayload() const;
+      bool fromPayload(const std::string & payload);
+   };
+
+   /**
+    AckCoalescer keeps track of the sequence numbers of the packages received from each sending node,
+    and builds ack packages which acknowledge all the packages received since the previous ack at once.
+    The NetworkReader sends the acks after a short delay or when enough packages have arrived, so one
+    ack datagram acknowledges up to hundreds of packages instead of one ack per package.<p>
+    The acks also give each sender credit: the free space in the input queue of the receiver, shared
+    between the senders which have sent packages recently. A sender given no credit stops sending, and
+    requestCreditUpdates() tells it when there is space again. Senders idle for long are forgotten.
+    */
+   class AckCoalescer {
+   public:
+      /** What received() found out about a package. */
+      enum Arrival {
+         New, /*!< The package had not arrived before. */
+         Duplicate, /*!< The package has already arrived; the sender resent it since it has not got the ack. */
+         Overflow /*!< Too many packages above the missing ones have arrived to remember this one. It is not
+                   acknowledged and should be dropped, to be handled when the sender resends it. */
+      };
+
+      AckCoalescer();
+
+      Arrival received(const boost::asio::ip::udp::endpoint & origin, std::uint32_t stream, std::uint64_t sequence, std::uint64_t base = 0);
+      bool hasArrived(const boost::asio::ip::udp::endpoint & origin, std::uint32_t stream, std::uint64_t sequence) const;
+      bool shouldAckNow() const;
+      bool hasPendingAcks() const;
+      void takeAcks(std::vector<Package> & acks, std::int64_t freeSlots = -1);
+      bool hasStarvedOrigins() const;
+      void requestCreditUpdates();
+      void clear();
+
+   private:
+      AckCoalescer(const AckCoalescer &) = delete;
+      const AckCoalescer & operator =(const AckCoalescer &) = delete;
+
+      /** The packages received from one sending node. */
+      struct Origin {
+         /** The stream of the sender. A new stream means the sender was restarted. */
+         std::uint32_t stream;
+         /** All the packages up to this sequence number have arrived. */
+         std::uint64_t cumulative;
+         /** Packages above the cumulative sequence number which have arrived. */
+         std::set<std::uint64_t> above;
+         /** Packages received since the previous ack. */
+         std::size_t unacknowledged;
+         /** True if the sender was given no credit in the previous ack. */
+         bool starved;
+         /** When packages from the sender were last acknowledged. */
+         std::chrono::steady_clock::time_point lastActive;
+      };
+
+      void forgetIdleOrigins(std::chrono::steady_clock::time_point now);
+
+   private:
+      /** The senders, by their address and listening port. */
+      std::map<boost::asio::ip::udp::endpoint, Origin> origins;
+      /** Number of senders with packages not acknowledged yet. */
+      std::size_t pendingOrigins;
+      /** The largest number of packages received from one sender since the previous ack. */
+      std::size_t mostUnacknowledged;
+      /** Number of senders given no credit. */
+      std::size_t starvedOrigins;
+
+      /** Logging tag. */
+      static const std::string TAG;
+   };
+
+} //namespace
@@ -0,0 +1,135 @@
+//
+//  AckTable.h
+//  ProcessorNode
+//
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <chrono>
+#include <random>
+#include <cstdint>
+
+#include <boost/asio.hpp>
+#include <boost/uuid/uuid.hpp>
+
+#include <ProcessorNode/Package.h>
+#include <ProcessorNode/TimerWheel.h>
+#include <ProcessorNode/RetransmissionTimer.h>
+#include <ProcessorNode/AckCoalescer.h>
+
+namespace OHARBase {
+
+   /**
+    AckTable holds the packages the NetworkWriter has sent and which the next node has not yet
+    acknowledged. Packages are found by their uuid and destination from a hash table, so adding
+    a package and removing it when the ack arrives take constant time. The resend deadline of
+    each package is held in a TimerWheel, so finding the packages whose deadline has passed
+    costs only the expired packages, even with a hundred thousand packages waiting for an ack.<p>
+    The round trip time to each destination is measured from the acks, and the resend deadline of
+    a package is derived from it with RetransmissionTimer. Each resend of a package doubles the deadline,
+    and after the maximum number of resends the package is given up.<p>
+    Packages sent to each destination are numbered in a stream of their own, so that the next node
+    can acknowledge all the packages received so far with one SequenceAck. Each package also carries the
+    lowest sequence number still waiting for the ack, so that the next node does not wait for the packages
+    given up, nor for the packages acknowledged before it was restarted. The acks give the credit of
+    the stream, how many packages the next node can take, and a sender with no credit left only probes
+    the next node now and then with one package.
+    */
+   class AckTable {
+   public:
+      AckTable();
+
+      void add(const Package & package, const boost::asio::ip::udp::endpoint & target, std::chrono::steady_clock::time_point now);
+      void sequence(Package & package, const boost::asio::ip::udp::endpoint & target);
+      bool acknowledge(const Package & ack, std::chrono::steady_clock::time_point now, std::vector<boost::uuids::uuid> * uuids = nullptr);
+      std::size_t acknowledge(const SequenceAck & ack, std::chrono::steady_clock::time_point now, std::vector<boost::uuids::uuid> * uuids = nullptr);
+      void takeExpired(std::chrono::steady_clock::time_point now, std::vector<Package> & resend, std::vector<Package> & givenUp);
+      std::chrono::steady_clock::time_point nextDeadline() const;
+
+      void setMaxResends(int resends);
+      int getMaxResends() const;
+      const RetransmissionTimer & roundTrip(const boost::asio::ip::udp::endpoint & target);
+
+      std::size_t inFlight(const boost::asio::ip::udp::endpoint & target) const;
+      std::size_t credit(const boost::asio::ip::udp::endpoint & target) const;
+      bool probe(const boost::asio::ip::udp::endpoint & target, std::chrono::steady_clock::time_point now);
+      std::chrono::steady_clock::time_point nextProbe() const;
+      std::size_t size() const;
+      bool isEmpty() const;
+      void clear();
+
+   private:
+      AckTable(const AckTable &) = delete;
+      const AckTable & operator =(const AckTable &) = delete;
+
+      /** Packages are identified by the uuid and the package specific destination,
+       since a package sent to several destinations must be acknowledged by each of them. */
+      struct Key {
+         boost::uuids::uuid uuid;
+         boost::asio::ip::udp::endpoint destination;
+         bool operator ==(const Key & other) const;
+      };
+      /** Hash function for the keys. */
+      struct KeyHash {
+         std::size_t operator ()(const Key & key) const;
+      };
+      /** A package waiting for the ack. */
+      struct Entry {
+         /** The package sent. */
+         Package package;
+         /** Where the package was sent to. */
+         boost::asio::ip::udp::endpoint target;
+         /** When the package was last sent. */
+         std::chrono::steady_clock::time_point sent;
+         /** How many times the package has been sent. */
+         int attempts;
+         /** Incremented each time the entry is reused, so that timers of earlier packages are ignored. */
+         std::uint32_t generation;
+      };
+
+      /** The packages sent to one destination, numbered in sequence. */
+      struct Stream {
+         /** The destination. */
+         boost::asio::ip::udp::endpoint target;
+         /** Sequence number of the next package. */
+         std::uint64_t nextSequence;
+         /** Entries of the packages waiting for the ack, by their sequence numbers. */
+         std::map<std::uint64_t, std::uint32_t> pending;
+         /** How many packages the destination can take, -1 if it does not limit it. */
+         std::int64_t credit;
+         /** Probes sent since the credit ran out. */
+         int probes;
+         /** When to send the next probe, if the credit has run out. */
+         std::chrono::steady_clock::time_point nextProbe;
+      };
+
+      void remove(std::uint32_t index);
+      void release(std::uint32_t index);
+
+   private:
+      /** The entries, reused through the free list. */
+      std::vector<Entry> entries;
+      /** Indexes of the unused entries. */
+      std::vector<std::uint32_t> freeEntries;
+      /** Index of the entry of each package waiting for the ack. */
+      std::unordered_map<Key, std::uint32_t, KeyHash> index;
+      /** The resend deadlines, identified by the entry index and generation. */
+      TimerWheel timers;
+      /** Ids of the expired timers, reused between calls. */
+      std::vector<std::uint64_t> expiredTimers;
+      /** Round trip estimates of the destinations. */
+      std::map<boost::asio::ip::udp::endpoint, RetransmissionTimer> roundTrips;
+      /** How many times a package is resent before it is given up. */
+      int maxResends;
+      /** The streams, by their ids. */
+      std::unordered_map<std::uint32_t, Stream> streams;
+      /** The stream id of each destination. */
+      std::map<boost::asio::ip::udp::endpoint, std::uint32_t> targetStreams;
+      /** Generates the stream ids. */
+      std::mt19937 streamIds;
+   };
+
+} //namespace
@@ -0,0 +1,52 @@
+//
+//  BinaryEnvelope.h
+//  ProcessorNode
+//
+
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+#include <ProcessorNode/Package.h>
+
+namespace OHARBase {
+
+   /**
+    BinaryEnvelope is a compact binary serialization of a Package, an alternative to the JSON
+    serialization. The envelope is:<br />
+    <ul>
+    <li>magic byte 0x1E, which can never start a JSON package nor a fragment,</li>
+    <li>envelope format version (1 byte),</li>
+    <li>uuid of the package (16 bytes),</li>
+    <li>type of the package (1 byte, the value of Package::Type),</li>
+    <li>flags (1 byte): 0x01 if the sender's listening port follows, 0x02 if the stream and sequence number follow,
+    0x04 if the payload is the JSON text of a JSON value payload, 0x08 if the base of the sequence follows the sequence number,</li>
+    <li>the sender's listening port, the stream, the sequence number and its base, if flagged (varints),</li>
+    <li>length of the payload (varint),</li>
+    <li>the payload bytes as such.</li>
+    </ul>
+    Varints are unsigned LEB128: seven bits at a time, least significant first, the high bit set in all but the last byte.
+    A package is 20 bytes plus the payload and a few bytes of varints, where the JSON serialization
+    is about 80 bytes plus the payload with its characters escaped. Receivers tell the envelope from
+    JSON by the first byte, so nodes sending JSON and nodes sending envelopes can be mixed.
+    */
+   class BinaryEnvelope {
+   public:
+      /** The first byte of each envelope. */
+      static const std::uint8_t Magic = 0x1E;
+      /** The version of the envelope format. */
+      static const std::uint8_t Version = 1;
+
+      static bool isEnvelope(const char * data, std::size_t length);
+      static void encode(const Package & package, std::string & data);
+      static void decode(const char * data, std::size_t length, Package & package);
+
+   private:
+      BinaryEnvelope() = delete;
+
+      static void appendVarint(std::uint64_t value, std::string & data);
+      static std::uint64_t readVarint(const unsigned char * & position, const unsigned char * end);
+   };
+
+} //namespace
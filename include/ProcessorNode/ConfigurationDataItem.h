@@ -34,6 +34,21 @@ public:
    static const std::string CONF_NODENAME;
    static const std::string CONF_ENCRYPT;
    static const std::string CONF_USE_ACK;
+   static const std::string CONF_INPUT_BATCH;
+   static const std::string CONF_INPUT_SHARDS;
+   static const std::string CONF_OUTPUT_BATCH;
+   static const std::string CONF_MAX_PACKAGE_SIZE;
+   static const std::string CONF_ROUTES;
+   static const std::string CONF_ACK_RETRIES;
+   static const std::string CONF_ACK_WINDOW;
+   static const std::string CONF_QUEUE_LIMIT;
+   static const std::string CONF_OUTPUT_RATE;
+   static const std::string CONF_QUEUE_BYTES;
+   static const std::string CONF_QUEUE_OVERFLOW;
+   static const std::string CONF_OUTPUT_LOG;
+   static const std::string CONF_OUTPUT_FORMAT;
+   static const std::string CONF_CUT_THROUGH;
+   static const std::string CONF_UUID_VERSION;
    
    void setItemName(const std::string &item);
    void setItemValue(const std::string &value);
@@ -0,0 +1,78 @@
+//
+//  FragmentAssembler.h
+//  ProcessorNode
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+
+#include <boost/asio.hpp>
+#include <boost/uuid/uuid.hpp>
+
+#include <ProcessorNode/Fragmenter.h>
+
+namespace OHARBase {
+
+   /**
+    FragmentAssembler puts received package fragments back together. Fragments are
+    collected per sender and package uuid. Reassembly buffers are bounded: a package may not
+    be larger than the configured maximum package size, only a limited number of packages may
+    be under reassembly at a time, and packages whose fragments have not all arrived within
+    the timeout are evicted. The fragment count of a package must be the one the Fragmenter gives
+    for its length and the datagram size, so a forged header cannot make the assembler allocate
+    more fragments than the package needs.
+    @see Fragmenter
+    */
+   class FragmentAssembler {
+   public:
+      explicit FragmentAssembler(std::size_t maxDatagramSize);
+
+      void setMaxPackageSize(std::size_t size);
+      std::size_t getMaxPackageSize() const;
+
+      bool add(const char * data, std::size_t length, const boost::asio::ip::udp::endpoint & from, std::string & package);
+
+      std::size_t packagesUnderReassembly() const;
+
+   private:
+      FragmentAssembler(const FragmentAssembler &) = delete;
+      const FragmentAssembler & operator =(const FragmentAssembler &) = delete;
+
+      void evictExpired(const std::chrono::steady_clock::time_point & now);
+      void evictOldest();
+
+   private:
+      /** A package under reassembly. */
+      struct Assembly {
+         /** The fragments received so far, indexed by the fragment index. */
+         std::vector<std::string> fragments;
+         /** How many of the fragments have been received. */
+         std::size_t received;
+         /** Number of bytes received so far. */
+         std::size_t bytes;
+         /** The length of the whole package, from the fragment header. */
+         std::size_t totalLength;
+         /** When the first fragment of the package arrived. */
+         std::chrono::steady_clock::time_point started;
+      };
+      /** Packages are identified by the sender address and the package uuid. */
+      using AssemblyKey = std::pair<boost::asio::ip::udp::endpoint, boost::uuids::uuid>;
+
+      /** Packages under reassembly. */
+      std::map<AssemblyKey, Assembly> assemblies;
+      /** Total number of bytes held in the reassembly buffers. */
+      std::size_t bufferedBytes;
+      /** Maximum size of a reassembled package. */
+      std::size_t maxPackageSize;
+      /** Size of the package data in each fragment but the last, the datagram size less the fragment header. */
+      std::size_t chunkSize;
+
+      /** Logging tag. */
+      static const std::string TAG;
+   };
+
+} //namespace
@@ -0,0 +1,60 @@
+//
+//  Fragmenter.h
+//  ProcessorNode
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <boost/uuid/uuid.hpp>
+
+namespace OHARBase {
+
+   /**
+    Fragmenter splits serialized packages too large for one datagram into fragments, and
+    parses the fragment header of received fragments. Each fragment starts with a binary header:<br />
+    <ul>
+    <li>magic byte 0x1F, which can never start a JSON package,</li>
+    <li>fragment format version (1 byte),</li>
+    <li>uuid of the package the fragment belongs to (16 bytes),</li>
+    <li>index of the fragment (2 bytes, network byte order),</li>
+    <li>number of fragments in the package (2 bytes, network byte order),</li>
+    <li>total length of the serialized package (4 bytes, network byte order).</li>
+    </ul>
+    The header is followed by the fragment's share of the serialized package. Fragments are put
+    back together by the FragmentAssembler.
+    @see FragmentAssembler
+    */
+   class Fragmenter {
+   public:
+      /** The first byte of each fragment. */
+      static const std::uint8_t Magic = 0x1F;
+      /** The version of the fragment header format. */
+      static const std::uint8_t Version = 1;
+      /** Size of the fragment header in bytes. */
+      static const std::size_t HeaderSize = 26;
+
+      /** The header of a received fragment. */
+      struct Header {
+         /** Uuid of the package the fragment belongs to. */
+         boost::uuids::uuid uuid;
+         /** Index of the fragment, starting from zero. */
+         std::uint16_t index;
+         /** How many fragments the package was split into. */
+         std::uint16_t count;
+         /** Length of the whole serialized package. */
+         std::uint32_t totalLength;
+      };
+
+      static bool isFragment(const char * data, std::size_t length);
+      static bool parseHeader(const char * data, std::size_t length, Header & header);
+      static std::size_t split(const boost::uuids::uuid & id, const std::string & data, std::size_t maxDatagramSize, std::vector<std::string> & fragments);
+
+   private:
+      Fragmenter() = delete;
+   };
+
+} //namespace
@@ -8,7 +8,14 @@
 
 #pragma once
 
+#include <vector>
+#include <memory>
+
 #include <ProcessorNode/Networker.h>
+#include <ProcessorNode/FragmentAssembler.h>
+#include <ProcessorNode/StreamListener.h>
+#include <ProcessorNode/SharedMemoryRing.h>
+#include <ProcessorNode/AckCoalescer.h>
 
 namespace OHARBase {
 	
@@ -31,6 +38,29 @@ namespace OHARBase {
 		
 		Package read();
 		
+      virtual int packagesInQueue() const override;
+      virtual int packagesInQueue(Package::Type type) const override;
+      virtual unsigned long long packagesDropped() const override;
+      
+      void setBatchSize(int size);
+      int getBatchSize() const;
+      
+      void setMaxPackageSize(std::size_t size);
+      
+      void setQueueLimit(std::size_t packages);
+      void setQueueBytes(std::size_t bytes);
+      void setOverflow(PackageQueue::Overflow policy);
+      
+      void setTransport(Transport t);
+      Transport getTransport() const;
+      void setSharedMemoryRing(const std::string & name);
+      
+      void setShardCount(int count);
+      int getShardCount() const;
+      
+      void setCutThrough(bool enabled);
+      bool isCutThrough() const;
+      
 	private:
 		NetworkReader() = delete;
 		NetworkReader(const NetworkReader &) = delete;
@@ -40,6 +70,22 @@ namespace OHARBase {
 		void handleReceive(const boost::system::error_code & error, std::size_t bytes_transferred);
 		
       void readSocket();
+      void waitForDatagrams();
+      void handleReadable(const boost::system::error_code & error);
+      std::size_t receiveBatch();
+      
+      bool parseDatagram(const char * data, std::size_t length, const boost::asio::ip::udp::endpoint & from, Package & package);
+      bool parsePackage(const char * data, std::size_t length, const boost::asio::ip::address & from, unsigned short fromPort, Package & package);
+      void handleFrames(std::vector<std::string> & frames, const boost::asio::ip::tcp::endpoint & from);
+      void readRing();
+      void startShards(bool useAcknowledgements);
+      void stopShards();
+      void enqueue(std::vector<Package> & packages);
+      std::int64_t freeSlots() const;
+      bool hasPriorityPackages();
+      void sendAcks();
+      void scheduleAcks();
+      void handleAckTimer(const boost::system::error_code & error);
       
 	private:
 				
@@ -48,6 +94,9 @@ namespace OHARBase {
 		 read() and handle it. */
 		NetworkReaderObserver & observer;
 		
+		/** The io service running the asynchronous reads. */
+		boost::asio::io_service & ioService;
+		
       /** The address of the sender whose packages we are handling. */
       boost::asio::ip::udp::endpoint remote_endpoint;
       
@@ -59,6 +108,61 @@ namespace OHARBase {
 		
       /** Send ack messages for packages received or not. */
       bool sendAckMessages;
+      /** Keeps track of the sequence numbers received, for acknowledging many packages with one ack. */
+      AckCoalescer coalescer;
+      /** Delays the acks so that they can be coalesced. */
+      boost::asio::steady_timer ackTimer;
+      /** True when the ack timer is running. */
+      bool ackTimerRunning;
+      /** The ack packages to send to the senders, reused between acks. */
+      std::vector<Package> ackPackages;
+      /** The acks received from the next node, to be given to the observer. */
+      std::vector<Package> receivedAcks;
+      /** How many packages the queue should hold at most. The free space is given to the senders as credit
+       in the acks, 0 for no limit. */
+      std::size_t queueLimit;
+      /** How many bytes of packages the queue holds at most, 0 for no limit. */
+      std::size_t queueBytes;
+      
+      /** How many datagrams are drained from the socket per readiness event. If 1,
+       datagrams are received one by one with async_receive_from. */
+      int batchSize;
+      /** Ring of receive buffers used in batched mode, one buffer for each datagram in a batch. */
+      std::vector<boost::array<char, BufferSize>> receiveRing;
+      /** Sender addresses of the datagrams in the receiveRing. */
+      std::vector<boost::asio::ip::udp::endpoint> ringEndpoints;
+      /** Lengths of the datagrams in the receiveRing. */
+      std::vector<std::size_t> ringLengths;
+      
+      /** Puts together packages which were too large for one datagram and were sent in fragments. */
+      FragmentAssembler assembler;
+      
+      /** Whether packages are received as datagrams or from TCP connections. */
+      Transport transport;
+      /** Accepts the TCP connections and reads the frames, when using the stream transport. */
+      std::unique_ptr<StreamListener> streamListener;
+      /** Name of the shared memory ring, when using the shared memory transport. */
+      std::string ringName;
+      /** The shared memory ring packages are read from. */
+      std::unique_ptr<SharedMemoryRing> ring;
+      /** The thread reading the shared memory ring. */
+      std::thread * ringThread;
+      
+      /** How many sockets the input port is opened with. */
+      int shardCount;
+      /** Open the port with SO_REUSEPORT, so that the kernel balances the datagrams between the sockets of the shards. */
+      bool doReusePort;
+      /** The io services of the shards, each run by a thread of its own. */
+      std::vector<std::unique_ptr<boost::asio::io_service>> shardServices;
+      /** The readers of the shards, each with its own socket and queue. */
+      std::vector<std::unique_ptr<NetworkReader>> shards;
+      /** The threads running the io services of the shards. */
+      std::vector<std::thread> shardThreads;
+      /** The shard read() takes the next package from, so that the shards are handled in turns. */
+      std::size_t nextShard;
+      
+      /** Read data packages in JSON with PackageScanner, keeping the payload unparsed until asked for. */
+      bool cutThrough;
 	};
 	
 	
@@ -10,6 +10,7 @@
 
 namespace OHARBase {
 	
+   class Package;
 	
 	/** Interface for observing the NetworkReader. Network reader notifies
 	 the observer using this interface when data has arrived and is ready
@@ -24,6 +25,11 @@ namespace OHARBase {
         /** NetworkReader calls this method if it cannot parse/handle the data that was received.
          @param what What went wrong in data handling. */
       virtual void errorInData(const std::string & what) = 0;
+      /** NetworkReader calls this method when an ack from the next node has been received, when acks
+       are used. Acks are not put into the queue of the reader, so that they are handled without waiting
+       for the data received before them.
+       @param ack The ack package. */
+      virtual void receivedAcknowledgement(const Package & ack) = 0;
 	};
 	
 	
@@ -9,19 +9,38 @@
 #pragma once
 
 #include <queue>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <atomic>
 #include <condition_variable>
 
+#include <boost/uuid/uuid.hpp>
+#include <boost/functional/hash.hpp>
+
 #include <ProcessorNode/Networker.h>
 #include <ProcessorNode/Package.h>
+#include <ProcessorNode/PackageRouter.h>
+#include <ProcessorNode/OutputConnection.h>
+#include <ProcessorNode/AckTable.h>
+#include <ProcessorNode/RateLimiter.h>
+#include <ProcessorNode/PackageLog.h>
+#include <ProcessorNode/NetworkWriterObserver.h>
 
 namespace OHARBase {
 	
-   //TODO: 1..n destination addresses instead of only one.
-   //TODO: Rules for specifying to which output address to send the package to.
-	/** NetworkWriter handles the sending of the data packages to the next node.
-	 It contains a queue of data packages to send. Sending happens in a separate thread
+	/** NetworkWriter handles the sending of the data packages to the next node or nodes.
+	 It contains a queue of data packages to send. Packages can be sent to several destinations;
+	 each package is serialized once and the same bytes are sent to all of them. Destinations given as
+	 tcp://host:port are sent to over persistent TCP connections (see StreamConnection), destinations given as shm://name
+	 through shared memory rings (see SharedMemoryConnection), and others as UDP datagrams. Sending happens in a separate thread
 	 in order to keep the main thread responsive to user actions as well
 	 as to enable handling and receiving the data from other nodes separately.
+	 With a package log (see setLog()), the data packages are kept on disk until delivered and sent again
+	 when the writer is started the next time, and packages over the queue limit are spilled to the log
+	 instead of waiting or being dropped.
 	 @author Antti Juustila
 	 */
 	class NetworkWriter : public Networker {
@@ -34,7 +53,33 @@ namespace OHARBase {
 		virtual void stop() override;
 		
 		void write(const Package & data);
+		void write(Package && data);
+		void acknowledge(const Package & ack);
 		
+      void addDestination(const std::string & hostName);
+      std::size_t destinationCount() const;
+      void setRoutes(const std::string & rules);
+      void setObserver(NetworkWriterObserver * obs);
+      void setMaxResends(int resends);
+      void setWindow(std::size_t packages);
+      std::size_t getWindow() const;
+      void setQueueLimit(std::size_t packages);
+      void setQueueBytes(std::size_t bytes);
+      void setOverflow(PackageQueue::Overflow policy);
+      void setRates(const std::string & limits);
+      void setLog(const std::string & directory);
+      void setFormat(Format packageFormat);
+      Format getFormat() const;
+      
+      void setBatchSize(int size);
+      int getBatchSize() const;
+      
+      void setMaxPackageSize(std::size_t size);
+      std::size_t getMaxPackageSize() const;
+      
+      unsigned long long getFlushCount() const;
+      unsigned long long getFlushedPackageCount() const;
+      
 	private:
 		NetworkWriter() = delete;
 		NetworkWriter(const NetworkWriter &) = delete;
@@ -42,20 +87,63 @@ namespace OHARBase {
 		
 		void threadFunc();
 		
-		void handleSend(const boost::system::error_code& error,
-							 std::size_t bytes_transferred);
-      
+		void handlePackages(std::vector<Package> & packages);
 		void handlePackage(const Package & package);
+		void queueDatagrams(const Package & package, std::string & serialized, const boost::asio::ip::udp::endpoint * targets, std::size_t targetCount);
+		void sendNumbered(Package & package, const boost::asio::ip::udp::endpoint & target, std::chrono::steady_clock::time_point now);
+		void serialize(const Package & package, std::string & serialized) const;
+		void sendPaced(const Package & package, const boost::asio::ip::udp::endpoint & target, std::chrono::steady_clock::time_point now);
+		bool mustHold(const boost::asio::ip::udp::endpoint & target, bool numbered, std::chrono::steady_clock::time_point now);
+		std::size_t windowOf(const boost::asio::ip::udp::endpoint & target) const;
+		void hold(const boost::asio::ip::udp::endpoint & target, Package && package);
+		bool canHoldMore() const;
+		void connectionDrained();
+		void releaseHeldPackages();
+		std::chrono::steady_clock::time_point nextRelease() const;
+		void reportRates();
+		std::size_t addSendBuffer(std::string & data);
+		void queueDatagram(std::size_t bufferIndex, const boost::asio::ip::udp::endpoint & destination);
+		void flush();
+		void flushConnections();
       void handleAcknowledgementMessages(const Package & package);
       void handlePackagesNotAcknowledgedUntilTimeout();
-      bool timeToCheckPackagesToResend();
+      void updateLog();
+      void logSent(const Package & package, std::size_t pending);
+      void logDone(const boost::uuids::uuid & uuid);
       
 	private:
 		
-      /** Has the resolved endpoint to use for sending data. */
-      boost::asio::ip::udp::endpoint resolvedEndpoint;
-		/** Contains the data which is currenty being sent, in a string. */
-		std::string currentlySending;
+      /** Destination addresses given in addition to the host and port of the writer. */
+      std::vector<std::string> additionalDestinations;
+      /** The endpoints packages are sent to, unless a package has its own destination or a routing rule matches. */
+      std::vector<boost::asio::ip::udp::endpoint> destinations;
+      /** The transport used for the host and port given in the constructor. */
+      Transport transport;
+      /** Connections to the destinations using the stream or shared memory transport. */
+      std::vector<std::unique_ptr<OutputConnection>> connections;
+      /** Routing rules selecting the destinations by package contents. */
+      PackageRouter router;
+      /** Holds the destination of a package with a package specific destination. */
+      std::vector<boost::asio::ip::udp::endpoint> packageDestination;
+		/** Pool of buffers holding the serialized packages of the batch currently being sent.
+		 Buffers are reused from batch to batch. */
+		std::vector<std::string> sendBuffers;
+		/** Number of buffers in sendBuffers used in the current batch. */
+		std::size_t pendingBuffers;
+		/** Datagrams to send in the next flush: index of the send buffer and the destination address. */
+		std::vector<std::pair<std::size_t, boost::asio::ip::udp::endpoint>> sendMessages;
+		/** Number of datagrams in sendMessages waiting to be flushed. */
+		std::size_t pendingSends;
+		/** Fragments of a package too large to fit into one datagram. */
+		std::vector<std::string> fragments;
+		/** Maximum size of a serialized package. Packages larger than a datagram are sent in fragments. */
+		std::size_t maxPackageSize;
+		/** How many packages at most are taken from the queue and sent in one flush. */
+		int batchSize;
+		/** How many times the pending packages have been flushed to the socket. */
+		std::atomic<unsigned long long> flushCount;
+		/** How many packages have been flushed to the socket in total. */
+		std::atomic<unsigned long long> flushedPackages;
 		/** The condition variable used to signal the sending thread that new data is available
 		 in the queue. */
 		std::condition_variable condition;
@@ -67,10 +155,69 @@ namespace OHARBase {
       // Acknowledgements
       /** Create acknowledgement messages for packages if true. */
       bool acknowledgePackages;
-      /** A container for sent messages. Removed from here when ack is received from the next Node. */
-      std::vector<Package> sentPackages;
-      /** Time since the last time sent messages were resent if not acknowledged. */
-      std::chrono::system_clock::time_point lastTimeResendWasChecked;
+      /** A container for sent messages. Removed from here when ack is received from the next Node,
+       and resent if the ack does not arrive before the deadline of the package. */
+      AckTable sentPackages;
+      /** The packages taken from sentPackages to be resent, reused between resends. */
+      std::vector<Package> expiredPackages;
+      /** The packages given up after the maximum number of resends. */
+      std::vector<Package> givenUpPackages;
+      /** Notified of the packages given up, may be null. */
+      NetworkWriterObserver * observer;
+      /** Acks from the next node, handled by the writer thread before the packages in the queue. */
+      std::vector<Package> receivedAcks;
+      /** The acks taken from receivedAcks to be handled, reused between loops. */
+      std::vector<Package> acksToHandle;
+      /** How many numbered packages sent to a destination may wait for the ack at a time, 0 for no limit. */
+      std::size_t window;
+      /** Packages waiting for the window of their destination to open, by the destination. */
+      std::map<boost::asio::ip::udp::endpoint, std::deque<Package>> heldPackages;
+      /** Number of packages in heldPackages. */
+      std::size_t heldCount;
+      /** Size of the packages in heldPackages, counted as in the send queue. */
+      std::size_t heldBytes;
+      /** How many packages may be held at most before data packages are no longer taken from the queue, 0 for no limit. */
+      std::size_t heldLimit;
+      /** How many bytes of packages may be held at most before data packages are no longer taken from the queue, 0 for no limit. */
+      std::size_t heldByteLimit;
+      /** Signals the threads waiting in write() that there is space in the queue. */
+      std::condition_variable space;
+      /** Paces the packages to the destinations with a rate limit. */
+      RateLimiter rates;
+      /** When the first held package over the rate may be sent, set when the held packages are released. */
+      std::chrono::steady_clock::time_point nextPaced;
+      /** The destinations a package is sent to now, the others being over their rate. */
+      std::vector<boost::asio::ip::udp::endpoint> pacedTargets;
+      /** The rates taken from the limiter for reporting, reused between reports. */
+      std::vector<RateLimiter::Rate> measuredRates;
+      /** The format the packages are sent in. */
+      Format format;
+
+      // Package log
+      /** A data package in the log, waiting to be delivered. */
+      struct Logged {
+         /** The id of the package in the log. */
+         std::uint64_t id;
+         /** How many destinations have yet to acknowledge the package, or the held packages yet to be sent. */
+         std::size_t pending;
+      };
+      /** The directory of the package log, empty for no log. */
+      std::string logDirectory;
+      /** The data packages written are kept here until delivered. Used with the guard locked. */
+      std::unique_ptr<PackageLog> log;
+      /** The log ids of the packages written, not yet taken by the writer thread. Used with the guard locked. */
+      std::unordered_map<boost::uuids::uuid, std::uint64_t, boost::hash<boost::uuids::uuid>> writtenIds;
+      /** The ids of the packages in the log only, since the queue was full when they were written.
+       They are put into the queue in order as it has space. Used with the guard locked. */
+      std::deque<std::uint64_t> spilled;
+      /** The packages in the log taken by the writer thread, by their uuid. */
+      std::unordered_map<boost::uuids::uuid, Logged, boost::hash<boost::uuids::uuid>> logged;
+      /** The log ids of the packages delivered, to be completed in the log. */
+      std::vector<std::uint64_t> completedIds;
+      /** The records of the log taken under the guard, flushed to the disk after releasing it. */
+      std::vector<PackageLog::Range> unsyncedRanges;
+      /** The uuids of the packages acknowledged, reused between acks. */
+      std::vector<boost::uuids::uuid> acknowledgedUuids;
 	};
 	
 }
@@ -0,0 +1,37 @@
+//
+//  NetworkWriterObserver.h
+//  ProcessorNode
+//
+
+#pragma once
+
+#include <cstddef>
+
+#include <boost/asio/ip/udp.hpp>
+
+namespace OHARBase {
+
+   class Package;
+
+   /** Interface for observing the NetworkWriter. Network writer notifies the observer
+    using this interface about packages it could not deliver, and about the rates of the
+    destinations with a rate limit.
+    */
+   class NetworkWriterObserver {
+   public:
+      /** NetworkWriter calls this method from the writer thread when a package sent with
+       acknowledgements was resent the maximum number of times without an ack, and the writer gave it up.
+       @param package The package given up. The destination of the package is the address it was sent to.
+       @param attempts How many times the package was sent. */
+      virtual void packageNotDelivered(const Package & package, int attempts) = 0;
+      /** NetworkWriter calls this method from the writer thread once a second for each destination
+       with a rate limit, while packages are sent.
+       @param destination The destination.
+       @param packagesPerSecond Packages sent to the destination per second since the previous call.
+       @param bytesPerSecond Bytes sent to the destination per second since the previous call.
+       @param throttled Packages waiting to be sent because the destination is over its rate or its
+       window is full, including the packages in the send queue behind them. */
+      virtual void sendRate(const boost::asio::ip::udp::endpoint & destination, double packagesPerSecond, double bytesPerSecond, std::size_t throttled) = 0;
+   };
+
+} // namespace
@@ -10,12 +10,13 @@
 
 #include <string>
 #include <thread>
-#include <queue>
+#include <mutex>
 
 #include <boost/array.hpp>
 #include <boost/asio.hpp>
 
 #include <ProcessorNode/Package.h>
+#include <ProcessorNode/PackageQueue.h>
 
 namespace OHARBase {
 	
@@ -31,6 +32,18 @@ namespace OHARBase {
 	 */
 	class Networker {
 	public:
+		/** The transport used for sending or receiving packages. */
+		enum class Transport {
+			Datagram, /*!< UDP datagrams, the default. */
+			Stream, /*!< Length-prefixed frames over TCP connections, addresses starting with tcp:// */
+			SharedMemory /*!< A shared memory ring between nodes on the same host, addresses starting with shm:// */
+		};
+		/** The format packages are serialized in when sent. Received packages may be in either format. */
+		enum class Format {
+			Json, /*!< JSON objects, the default. */
+			Binary /*!< The compact binary envelope, see BinaryEnvelope. */
+		};
+		
 		Networker(const std::string & hostName, boost::asio::io_service & io_s);
 		Networker(const std::string & hostName, int portNumber, boost::asio::io_service & io_s);
 		virtual ~Networker();
@@ -51,10 +64,16 @@ namespace OHARBase {
 		
       /** How many data packages are there in the sending/receiving queue.
        @return Number of data packages in the queue. */
-      int packagesInQueue() const;
+      virtual int packagesInQueue() const;
+      virtual int packagesInQueue(Package::Type type) const;
+      virtual unsigned long long packagesDropped() const;
 
       bool isRunning();
       
+      static Transport transportOf(const std::string & address);
+      static std::string addressWithoutScheme(const std::string & address);
+      static Format formatFrom(const std::string & format);
+      
 		
 	private:
 		Networker() = delete;
@@ -83,8 +102,9 @@ namespace OHARBase {
 
       /** A queue containing the data as Packages, received from the network.
        As more data could be received as this node could handle at a time, a queue is necessary to hold
-       the data so that the node can handle them without loosing any data. */
-      std::queue<Package> msgQueue;
+       the data so that the node can handle them without loosing any data. Control packages are
+       taken from the queue before the data packages. */
+      PackageQueue msgQueue;
       /** A mutex guards the access to the queue so that many threads do not manipulate the
        queue simultaneously. */
       std::mutex guard;
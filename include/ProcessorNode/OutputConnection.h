@@ -0,0 +1,44 @@
+//
+//  OutputConnection.h
+//  ProcessorNode
+//
+
+#pragma once
+
+#include <string>
+#include <chrono>
+
+namespace OHARBase {
+
+   /** Interface for the connection oriented destinations of the NetworkWriter, like TCP connections
+    and shared memory rings. The writer queues the serialized packages of a batch to the connection
+    and then flushes them. If the connection is down, the connection keeps the packages and the writer
+    flushes again when the connection may be opened again.
+    */
+   class OutputConnection {
+   public:
+      virtual ~OutputConnection() = default;
+
+      /** Gets the address of the destination, for logging.
+       @return The address. */
+      virtual const std::string & getAddress() const = 0;
+      /** Queues a serialized package to be sent in the next flush.
+       @param data The serialized package. */
+      virtual void queue(const std::string & data) = 0;
+      /** Sends the queued packages, opening the connection first if needed. */
+      virtual void flush() = 0;
+      /** Interrupts a blocking flush from another thread, when the writer is stopped. */
+      virtual void interrupt() = 0;
+      /** Use to query if there are packages waiting to be sent.
+       @return Returns true if packages are waiting. */
+      virtual bool hasPendingFrames() const = 0;
+      /** Use to query if the connection holds as many packages as it may. The writer then takes no more
+       data packages from its queue until the connection has sent some.
+       @return Returns true if the connection is full. */
+      virtual bool isFull() const = 0;
+      /** Gets the time when the connection is tried to be opened again, if it is not open.
+       @return The time of the next connection attempt. */
+      virtual std::chrono::steady_clock::time_point nextConnectAttempt() const = 0;
+   };
+
+} // namespace
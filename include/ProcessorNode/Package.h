@@ -8,10 +8,13 @@
 #pragma once
 
 #include <string>
+#include <memory>
 #include <variant>
+#include <cstdint>
 
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
+#include <boost/asio/ip/udp.hpp>
 
 #include <nlohmann/json.hpp>
 
@@ -60,21 +63,41 @@ namespace OHARBase {
       void setType(Type ptype);
       const std::string & getPayloadString() const;
       void setPayload(const std::string & d);
+      void setPayload(std::string && d);
       const DataItem * getPayloadObject() const;
       DataItem * getPayloadObject();
       void setPayload(std::unique_ptr<DataItem> item);
+      const nlohmann::json * getPayloadJson() const;
+      nlohmann::json * getPayloadJson();
+      void setPayloadJson(const nlohmann::json & value, std::size_t size = 0);
+      void setPayloadJson(nlohmann::json && value, std::size_t size = 0);
+      const std::string * getPayloadRawJson() const;
+      void setPayloadRawJson(std::string && text);
+      std::size_t payloadSize() const;
 
       void setOrigin(const std::string & o);
-      const std::string & origin() const;
+      void setOrigin(const boost::asio::ip::udp::endpoint & o);
+      std::string origin() const;
+      const boost::asio::ip::udp::endpoint & originEndpoint() const;
+      unsigned short originPort() const;
       bool hasOrigin() const;
 
       std::string getPackageOriginsListeningPort() const;
       std::string getPackageOriginsHost() const;
       
       void setDestination(const std::string & d);
-      const std::string & destination() const;
+      void setDestination(const boost::asio::ip::udp::endpoint & d);
+      std::string destination() const;
+      const boost::asio::ip::udp::endpoint & destinationEndpoint() const;
       bool hasDestination() const;
       
+      void setSequence(std::uint32_t streamId, std::uint64_t number);
+      std::uint32_t getStream() const;
+      std::uint64_t getSequence() const;
+      bool hasSequence() const;
+      void setSequenceBase(std::uint64_t number);
+      std::uint64_t getSequenceBase() const;
+      
       bool isEmpty() const;
       const Package & operator = (const Package & p);
       const Package & operator = (Package && p);
@@ -84,7 +107,24 @@ namespace OHARBase {
       void setTypeFromString(const std::string & typeStr);
       
    private:
-      void setPayloadVariant(const std::variant<std::string,std::unique_ptr<DataItem>> & x);
+      /** An immutable payload text, shared by the copies of a package. */
+      using Buffer = std::shared_ptr<const std::string>;
+      
+      /** A payload kept as the JSON text it was received in, not parsed yet. */
+      struct RawJson {
+         /** The JSON text of the payload. */
+         Buffer text;
+      };
+      
+      /** A payload embedded in the package JSON as a JSON value. */
+      struct JsonValue {
+         /** The payload value. */
+         std::shared_ptr<nlohmann::json> value;
+         /** The size of the JSON text the value was parsed from, zero if not known. */
+         std::size_t size;
+      };
+      
+      void parseRawPayload() const;
 
    private:
       /** The unique identifier for a package. Generated using the boost library support. */
@@ -100,20 +140,37 @@ namespace OHARBase {
        Data packages are application specific data items. */
       Type type;
       
-      /** Data as received from the network/sent to the network, either as JSON string or
-       parsed DataItem object pointer in managed pointer. Default value is an emptry string.
-       A c++17 std::variant holds either the JSON string or the parsed DataItem object.
+      /** Data as received from the network/sent to the network, either as JSON string,
+       parsed DataItem object pointer in managed pointer, a JSON value embedded in the package JSON,
+       or the JSON text of the payload not parsed yet. Default value is an emptry string, held as no buffer.
+       A c++17 std::variant holds either the JSON string, the parsed DataItem object, the JSON value or the JSON text.
+       The JSON text is parsed when the payload is asked for, so the variant is mutable.
+       The payload is reference counted and shared by the copies of the package, so copying a package for
+       several destinations, for resending or for the ack table does not copy the payload. A shared payload
+       is never modified: setting the payload replaces it, and a DataItem or a JSON value asked for
+       modifying is copied first if another package shares it.
        Contents of DataItem is application specific. Application developers
        subclass their data objects from DataItem and implement application specific data
        structures in their subclasses. Parsing of data from string to DataItem
        happens in other application specific classes. */
-      std::variant<std::string, std::unique_ptr<DataItem>> payload;
+      mutable std::variant<Buffer, std::shared_ptr<DataItem>, JsonValue, RawJson> payload;
 
-      /** Origin address of the package. */
-      std::string originAddress;
+      /** Origin address of the package, parsed. The address is unspecified if only the listening port
+       of the origin is known, and the port is zero if the origin is not known. */
+      boost::asio::ip::udp::endpoint originAddress;
+      
+      /** Destination address of the packet, parsed. Port is zero if the Node's default destination address is to be used. */
+      boost::asio::ip::udp::endpoint destinationAddress;
       
-      /** Destination address of the packet. Empty if the Node's default destination address is to be used. */
-      std::string destinationAddress;
+      /** The stream of packages from the sending node to one destination the package was sent in,
+       when acknowledgements are used. Zero if the package has no sequence number. */
+      std::uint32_t stream;
+      /** Sequence number of the package in the stream, starting from 1. Zero if the package has no sequence number. */
+      std::uint64_t sequence;
+      /** The lowest sequence number in the stream the sender still waits the ack for when the package was sent.
+       The packages below it have been acknowledged or given up, so the receiver need not wait for them.
+       Zero if not known. */
+      std::uint64_t base;
       
       /** Textual representation of the package type Package::Control. */
       static const std::string controlStr;
@@ -129,6 +186,7 @@ namespace OHARBase {
    
    void to_json(nlohmann::json & j, const Package & package);
    void from_json(const nlohmann::json & j, Package & package);
+   void dumpJson(const Package & package, std::string & serialized);
    
    
 } //namespace
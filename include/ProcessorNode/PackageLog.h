@@ -0,0 +1,120 @@
+//
+//  PackageLog.h
+//  ProcessorNode
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <cstdint>
+
+#include <ProcessorNode/Package.h>
+
+namespace OHARBase {
+
+   /**
+    PackageLog is a write-ahead log of the packages a NetworkWriter sends, kept on local disk until the
+    packages have been delivered. Packages are appended to the log, each with an id, and completed when
+    delivered. When the node is started again, the packages in the log not completed are sent again,
+    so no package is lost in a crash or a restart, though some may be delivered twice.<p>
+    The log is a directory of segment files of a fixed size, memory mapped, named after the id of their
+    first package. Each record has a header with the record kind, the length and a checksum, followed by
+    the package JSON. Completing a package appends a completion record with the id of the package.
+    A record with a bad checksum ends the segment, so a record torn in a crash is ignored. Segments are
+    deleted from the oldest when all the packages in them have been completed.<p>
+    Records are written to the mapped memory, so they survive a crash of the process; sync() flushes
+    them to the disk, so they survive a crash of the host too. The caller syncs a group of records at
+    a time. A caller guarding the log with a lock can take the ranges to flush with takeUnsynced() under
+    the lock, and flush them with sync(ranges) after releasing it. Supported in Linux and macOS.
+    */
+   class PackageLog {
+   public:
+      /** Default size of a segment file in bytes. */
+      static const std::size_t DefaultSegmentSize = 16 * 1024 * 1024;
+
+      /** Records written to a segment and not yet flushed to the disk. */
+      struct Range {
+         /** The start of the records, aligned to a page. */
+         char * data;
+         /** The length of the range in bytes. */
+         std::size_t length;
+         /** Path of the segment file. */
+         std::string path;
+      };
+
+      PackageLog(const std::string & directory, std::size_t segmentSize = DefaultSegmentSize);
+      ~PackageLog();
+
+      std::uint64_t append(const Package & package);
+      bool read(std::uint64_t id, Package & package) const;
+      void complete(std::uint64_t id);
+      void sync();
+      void takeUnsynced(std::vector<Range> & ranges);
+      static void sync(const std::vector<Range> & ranges);
+
+      void pendingIds(std::vector<std::uint64_t> & ids) const;
+      std::size_t pendingCount() const;
+      std::size_t segmentCount() const;
+
+   private:
+      PackageLog() = delete;
+      PackageLog(const PackageLog &) = delete;
+      const PackageLog & operator =(const PackageLog &) = delete;
+
+      struct RecordHeader;
+      /** A segment file, mapped to memory. */
+      struct Segment {
+         /** Path of the file. */
+         std::string path;
+         /** The file descriptor. */
+         int file;
+         /** The mapped file. */
+         char * data;
+         /** Size of the file. */
+         std::size_t size;
+         /** Bytes of records written. */
+         std::size_t used;
+         /** Bytes of records flushed to the disk. */
+         std::size_t synced;
+         /** Packages in the segment not yet completed. */
+         std::size_t pending;
+      };
+      /** Where the record of a package not yet completed is. */
+      struct Location {
+         /** The id of the first package of the segment. */
+         std::uint64_t segment;
+         /** Offset of the record in the segment. */
+         std::size_t offset;
+      };
+
+      void scan();
+      void scanSegment(std::uint64_t first, Segment & segment);
+      Segment & segmentFor(std::size_t recordSize);
+      void writeRecord(Segment & segment, std::uint32_t kind, std::uint64_t id, const std::string & data);
+      void removeCompletedSegments();
+      void closeSegment(Segment & segment, bool remove);
+      void syncDirectory();
+
+   private:
+      /** The directory of the segment files. */
+      std::string directory;
+      /** Size of a new segment file. */
+      std::size_t segmentSize;
+      /** The segments by the id of their first package, the last one being written to. */
+      std::map<std::uint64_t, Segment> segments;
+      /** The packages not yet completed. */
+      std::unordered_map<std::uint64_t, Location> records;
+      /** The id of the next package. */
+      std::uint64_t nextId;
+      /** True when records are appended to the last segment. Segments found when the log is opened are
+       not appended to, so the first package appended starts a new segment. */
+      bool appending;
+
+      /** Logging tag. */
+      static const std::string TAG;
+   };
+
+} //namespace
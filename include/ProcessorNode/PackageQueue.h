@@ -0,0 +1,110 @@
+//
+//  PackageQueue.h
+//  ProcessorNode
+//
+
+#pragma once
+
+#include <array>
+#include <queue>
+#include <string>
+#include <cstdint>
+
+#include <ProcessorNode/Package.h>
+
+namespace OHARBase {
+
+   /**
+    PackageQueue is the queue of packages received from or sent to the network. Each package type
+    has a lane of its own, and the lanes are served in strict priority: control packages first,
+    then acks and configuration packages, and data packages only when the other lanes are empty.
+    Packages of the same type keep their order. This way a shutdown command or a configuration read
+    does not wait behind tens of thousands of data packages.<p>
+    The queue may be limited in packages and in bytes. When a package arrives to a full queue,
+    makeRoom() applies the overflow policy of the queue, and the packages dropped are counted.<p>
+    The interface follows std::queue, with the number of packages in each lane available separately.
+    */
+   class PackageQueue {
+   public:
+      /** What is done when a package arrives to a full queue. */
+      enum class Overflow {
+         Block, /*!< The producer waits for space. Producers that cannot wait drop their data packages; other packages are queued over the limit. */
+         DropNewest, /*!< The arriving package is dropped. */
+         DropOldest, /*!< The packages that have waited the longest are dropped to make room. */
+         DropByType /*!< Packages of lower priority types are dropped to make room, data first. A package is dropped if there is nothing of lower priority to drop. */
+      };
+
+      PackageQueue();
+
+      void push(const Package & package);
+      void push(Package && package);
+      Package & front();
+      void pop();
+
+      bool empty() const;
+      std::size_t size() const;
+      std::size_t size(Package::Type type) const;
+      std::size_t bytes() const;
+      bool hasPriorityPackages() const;
+      void clear();
+
+      void setPackageLimit(std::size_t packages);
+      void setByteLimit(std::size_t limit);
+      void setOverflow(Overflow policy);
+      Overflow getOverflow() const;
+      bool isLimited() const;
+      bool hasSpaceFor(const Package & package) const;
+      bool makeRoom(const Package & package);
+      unsigned long long dropped() const;
+
+      static Overflow overflowFrom(const std::string & policy);
+      static std::size_t sizeOf(const Package & package);
+
+   private:
+      PackageQueue(const PackageQueue &) = delete;
+      const PackageQueue & operator =(const PackageQueue &) = delete;
+
+      /** The lanes in the order they are served. */
+      enum Lane {
+         ControlLane,
+         AcknowledgementLane,
+         ConfigurationLane,
+         DataLane,
+         LaneCount
+      };
+      /** A package in a lane. */
+      struct Entry {
+         /** The package. */
+         Package package;
+         /** The size of the package counted against the byte limit. */
+         std::size_t bytes;
+         /** The order the package arrived in, for finding the oldest package. */
+         std::uint64_t order;
+      };
+
+      static Lane laneOf(Package::Type type);
+      Lane firstLane() const;
+      Lane oldestLane() const;
+      Lane lastLane() const;
+      void drop(Lane lane);
+
+   private:
+      /** The packages of each lane. */
+      std::array<std::queue<Entry>, LaneCount> lanes;
+      /** The number of packages in all the lanes. */
+      std::size_t count;
+      /** The bytes of the packages in all the lanes. */
+      std::size_t totalBytes;
+      /** The order of the next package. */
+      std::uint64_t nextOrder;
+      /** The maximum number of packages, 0 for no limit. */
+      std::size_t packageLimit;
+      /** The maximum number of bytes, 0 for no limit. */
+      std::size_t byteLimit;
+      /** What is done when the queue is full. */
+      Overflow overflow;
+      /** The number of packages dropped. */
+      unsigned long long droppedCount;
+   };
+
+} //namespace
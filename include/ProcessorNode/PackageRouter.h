@@ -0,0 +1,86 @@
+//
+//  PackageRouter.h
+//  ProcessorNode
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include <ProcessorNode/Package.h>
+
+namespace OHARBase {
+
+   /**
+    PackageRouter selects the output addresses of a Package by the contents of the package.
+    Routing rules are given as a string (usually from the node configuration file) and they
+    are parsed once into a rule set, so routing a package does not need any string splitting
+    or address parsing.<p>
+    Rules are separated by semicolons. A rule has one or more conditions separated by &amp;,
+    followed by -> and the addresses (separated by commas) where packages matching all the
+    conditions are sent to. Conditions are:<br />
+    <ul>
+    <li>type=control -- the type of the package (control, data, configuration, acknowledgement),</li>
+    <li>id^=prefix -- the id of the payload DataItem, or the "id" field of a JSON payload, starts with the prefix,</li>
+    <li>field.name=value -- the top level field "name" of a JSON payload has the value.</li>
+    </ul>
+    For example: <code>type=control->10.0.0.5:50010;type=data&amp;field.size=large->10.0.0.6:50011</code><p>
+    Rules are evaluated in the order given, and the first matching rule decides the addresses.
+    Payloads are parsed as JSON only if a rule needs a field of the payload, and only once per package.
+    Payloads embedded as JSON values are not parsed again.
+    */
+   class PackageRouter {
+   public:
+      PackageRouter() = default;
+
+      void parse(const std::string & rules);
+      bool isEmpty() const;
+      std::size_t ruleCount() const;
+
+      const std::vector<boost::asio::ip::udp::endpoint> * route(const Package & package) const;
+
+   private:
+      PackageRouter(const PackageRouter &) = delete;
+      const PackageRouter & operator =(const PackageRouter &) = delete;
+
+   private:
+      /** A condition of a routing rule. */
+      struct Condition {
+         /** What the condition tests. */
+         enum Kind {
+            TypeEquals, /*!< Package type is the given type. */
+            IdPrefix, /*!< Payload id starts with the value. */
+            FieldEquals /*!< Payload field name has the value. */
+         };
+         /** What the condition tests. */
+         Kind kind;
+         /** The package type to match, for TypeEquals conditions. */
+         Package::Type type;
+         /** Name of the payload field, for FieldEquals conditions. */
+         std::string name;
+         /** The value or prefix to match. */
+         std::string value;
+      };
+      /** A routing rule: conditions which all must match, and addresses to send the package to. */
+      struct Rule {
+         /** Conditions of the rule. */
+         std::vector<Condition> conditions;
+         /** Where to send packages matching the conditions. */
+         std::vector<boost::asio::ip::udp::endpoint> targets;
+         /** True if some condition needs the payload parsed as JSON. */
+         bool needsPayload;
+      };
+
+      bool matches(const Condition & condition, const Package & package, const nlohmann::json & payload) const;
+
+      /** The rules in the order of evaluation. */
+      std::vector<Rule> rules;
+
+      /** Logging tag. */
+      static const std::string TAG;
+   };
+
+} //namespace
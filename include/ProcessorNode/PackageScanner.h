@@ -0,0 +1,41 @@
+//
+//  PackageScanner.h
+//  ProcessorNode
+//
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+#include <ProcessorNode/Package.h>
+
+namespace OHARBase {
+
+   /**
+    PackageScanner reads the fields of a data package from its JSON text without parsing the whole
+    JSON, for forwarding packages in the cut-through mode. The uuid, the type, the sender's listening
+    port and the sequence number with its base are read, while the payload is only skipped over and kept as raw
+    JSON text in the package. If no handler asks for the payload, it is sent on as it is, without
+    parsing, unescaping and escaping it again.<p>
+    The payload is checked only for matching brackets and quotes, so invalid JSON in a payload is
+    noticed only when the payload is parsed, possibly in a later node. Packages other than data
+    packages, and JSON the scanner does not handle (such as escapes in the package fields), are left
+    to be parsed as usual.
+    */
+   class PackageScanner {
+   public:
+      static bool scan(const char * data, std::size_t length, Package & package);
+
+   private:
+      PackageScanner() = delete;
+
+      static const char * skipSpace(const char * position, const char * end);
+      static const char * skipString(const char * position, const char * end);
+      static const char * skipValue(const char * position, const char * end);
+      static bool readString(const char * begin, const char * end, std::string_view & value);
+      static bool readNumber(const char * begin, const char * end, std::uint64_t & value);
+   };
+
+} //namespace
@@ -16,6 +16,7 @@
 #include <boost/asio.hpp>
 
 #include <ProcessorNode/NetworkReaderObserver.h>
+#include <ProcessorNode/NetworkWriterObserver.h>
 #include <ProcessorNode/Package.h>
 #include <ProcessorNode/ProcessorNodeObserver.h>
 
@@ -107,7 +108,7 @@ namespace OHARBase {
     format.
     @author Antti Juustila
     */
-   class ProcessorNode final : public NetworkReaderObserver {
+   class ProcessorNode final : public NetworkReaderObserver, public NetworkWriterObserver {
    public:
       // MARK: - Setup
       ProcessorNode(ProcessorNodeObserver * obs);
@@ -137,10 +138,15 @@ namespace OHARBase {
       
       virtual void receivedData() override;
       virtual void errorInData(const std::string & what) override;
+      virtual void receivedAcknowledgement(const Package & ack) override;
+      virtual void packageNotDelivered(const Package & package, int attempts) override;
+      virtual void sendRate(const boost::asio::ip::udp::endpoint & destination, double packagesPerSecond, double bytesPerSecond, std::size_t throttled) override;
       
       void sendData(Package & data);
+      void sendData(Package && data);
       
       void passToHandlers(Package & package);
+      void passToHandlers(Package && package);
       
       void passToNextHandlers(const DataHandler * current, Package & data);
       
@@ -166,8 +172,10 @@ namespace OHARBase {
       void initiateClientAppShutdown();
       
       void handlePackagesFrom(NetworkReader & reader);
+      bool offerToHandlers(Package & package);
+      void wakeIncomingHandler();
       
-      std::string listeningPort() const;
+      unsigned short listeningPort() const;
       
    protected:
       
@@ -220,7 +228,12 @@ namespace OHARBase {
       /** Condition variable for notifications between threads to indicate processing is
        needed in the other thread. */
       std::condition_variable condition;
-      /** Flag which is used to wait for incoming data. */
+      /** Mutex for the flag of incoming data. Not the guard, which the command handler thread holds
+       while handling a command, so that the reader threads are not kept waiting by the commands. */
+      std::mutex incomingGuard;
+      /** Condition variable the data handling thread waits for incoming data with. */
+      std::condition_variable incoming;
+      /** Flag which is used to wait for incoming data. Used with the incomingGuard locked. */
       bool hasIncoming;
       
       /** Command entered by the user or received from the previous node. */
@@ -0,0 +1,119 @@
+//
+//  RateLimiter.h
+//  ProcessorNode
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+
+#include <boost/asio.hpp>
+
+namespace OHARBase {
+
+   /**
+    TokenBucket limits the rate of something to a number of units (packages or bytes) per second.
+    Tokens are added at the rate, up to the burst size, and taken as the units are sent. The bucket
+    may go into debt by one send, so a package larger than the burst size is not held forever,
+    and the rate is kept on the average by waiting until the debt has been paid.
+    */
+   class TokenBucket {
+   public:
+      TokenBucket();
+      TokenBucket(double ratePerSecond, std::chrono::steady_clock::time_point now);
+
+      bool isLimited() const;
+      bool isAvailable(std::chrono::steady_clock::time_point now);
+      void take(double units, std::chrono::steady_clock::time_point now);
+      std::chrono::steady_clock::time_point availableAt() const;
+
+   private:
+      void refill(std::chrono::steady_clock::time_point now);
+
+   private:
+      /** Units per second, 0 for no limit. */
+      double rate;
+      /** The largest number of tokens the bucket holds. */
+      double burst;
+      /** Tokens in the bucket, negative when in debt. */
+      double tokens;
+      /** When the tokens were last added. */
+      std::chrono::steady_clock::time_point updated;
+   };
+
+   /**
+    RateLimiter paces the packages sent to each destination with a token bucket for packages per
+    second and another for bytes per second. The buckets hold only a millisecond's worth of tokens,
+    so the packages are sent evenly spread instead of in bursts.<p>
+    Limits are given as a string (usually from the node configuration file). Limits are separated by
+    semicolons, and each limit is the packages per second and the bytes per second separated by a comma,
+    0 for no limit. A limit without an address applies to every destination without a limit of its own,
+    and a limit for one destination is given as address=limit. For example
+    <code>2000,1000000;10.0.0.6:50011=500,0</code> limits each destination to 2000 packages and a
+    million bytes per second, except 10.0.0.6:50011 to 500 packages per second.<p>
+    The rates sent to the limited destinations are measured for reporting.
+    */
+   class RateLimiter {
+   public:
+      /** The measured sending rate to a destination. */
+      struct Rate {
+         /** The destination. */
+         boost::asio::ip::udp::endpoint target;
+         /** Packages sent per second. */
+         double packages;
+         /** Bytes sent per second. */
+         double bytes;
+      };
+
+      RateLimiter();
+
+      void parse(const std::string & limits);
+      bool isEmpty() const;
+
+      bool isAvailable(const boost::asio::ip::udp::endpoint & target, std::chrono::steady_clock::time_point now);
+      void take(const boost::asio::ip::udp::endpoint & target, std::size_t bytes, std::chrono::steady_clock::time_point now);
+      std::chrono::steady_clock::time_point availableAt(const boost::asio::ip::udp::endpoint & target);
+
+      std::chrono::steady_clock::time_point nextReport() const;
+      void takeRates(std::chrono::steady_clock::time_point now, std::vector<Rate> & rates);
+
+   private:
+      RateLimiter(const RateLimiter &) = delete;
+      const RateLimiter & operator =(const RateLimiter &) = delete;
+
+      /** Packages and bytes per second, 0 for no limit. */
+      struct Limit {
+         double packages;
+         double bytes;
+      };
+      /** The buckets of a destination, and what has been sent to it since the previous report. */
+      struct Destination {
+         TokenBucket packages;
+         TokenBucket bytes;
+         unsigned long long sentPackages;
+         unsigned long long sentBytes;
+      };
+
+      Destination * destinationOf(const boost::asio::ip::udp::endpoint & target, std::chrono::steady_clock::time_point now);
+      static Limit parseLimit(const std::string & limit);
+
+   private:
+      /** The limit of the destinations without a limit of their own. */
+      Limit defaultLimit;
+      /** The limits of the destinations given one. */
+      std::map<boost::asio::ip::udp::endpoint, Limit> limits;
+      /** The buckets of the destinations packages have been sent to. */
+      std::map<boost::asio::ip::udp::endpoint, Destination> destinations;
+      /** When the rates were last taken. */
+      std::chrono::steady_clock::time_point lastReport;
+      /** True if something has been sent since the rates were last taken. */
+      bool sentSinceReport;
+
+      /** Logging tag. */
+      static const std::string TAG;
+   };
+
+} //namespace
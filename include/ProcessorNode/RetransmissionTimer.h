@@ -0,0 +1,43 @@
+//
+//  RetransmissionTimer.h
+//  ProcessorNode
+//
+
+#pragma once
+
+#include <chrono>
+
+namespace OHARBase {
+
+   /**
+    RetransmissionTimer estimates the round trip time to one destination from the acks of the
+    packages sent there, and gives the time to wait for an ack before resending a package.
+    The estimate follows RFC 6298: the smoothed round trip time and its variation are updated
+    from each sample, and the timeout is the smoothed time plus four times the variation.
+    The timeout doubles with each resend of the same package, up to a maximum.<p>
+    Samples must be taken only from packages sent once, since the ack of a resent package
+    cannot be told apart from the ack of the original (Karn's algorithm).
+    */
+   class RetransmissionTimer {
+   public:
+      RetransmissionTimer();
+
+      void addSample(std::chrono::steady_clock::duration roundTrip);
+      std::chrono::steady_clock::duration timeout(int attempt) const;
+
+      bool hasSamples() const;
+      std::chrono::steady_clock::duration smoothedRoundTrip() const;
+      std::chrono::steady_clock::duration roundTripVariation() const;
+
+   private:
+      /** True after the first sample. */
+      bool sampled;
+      /** Smoothed round trip time. */
+      std::chrono::steady_clock::duration srtt;
+      /** Round trip time variation. */
+      std::chrono::steady_clock::duration rttvar;
+      /** Timeout of the first send of a package. */
+      std::chrono::steady_clock::duration rto;
+   };
+
+} //namespace
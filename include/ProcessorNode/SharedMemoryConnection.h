@@ -0,0 +1,67 @@
+//
+//  SharedMemoryConnection.h
+//  ProcessorNode
+//
+
+#pragma once
+
+#include <string>
+#include <deque>
+#include <memory>
+#include <chrono>
+#include <atomic>
+
+#include <ProcessorNode/OutputConnection.h>
+#include <ProcessorNode/SharedMemoryRing.h>
+
+namespace OHARBase {
+
+   /**
+    SharedMemoryConnection sends packages to a node on the same host through a SharedMemoryRing,
+    used by the NetworkWriter for destinations given as <code>shm://name</code>. Packages are written
+    directly into the ring while it is open, and the receiver is woken up once per flush. If the ring
+    is full, writing waits for the receiver to read. If the receiving node is not running, the packages
+    are kept (up to a limit) and the ring is opened again later.
+    */
+   class SharedMemoryConnection : public OutputConnection {
+   public:
+      SharedMemoryConnection(const std::string & ringName);
+      ~SharedMemoryConnection();
+
+      const std::string & getAddress() const override;
+
+      void queue(const std::string & data) override;
+      void flush() override;
+      void interrupt() override;
+
+      bool hasPendingFrames() const override;
+      bool isFull() const override;
+      std::chrono::steady_clock::time_point nextConnectAttempt() const override;
+
+   private:
+      SharedMemoryConnection() = delete;
+      SharedMemoryConnection(const SharedMemoryConnection &) = delete;
+      const SharedMemoryConnection & operator =(const SharedMemoryConnection &) = delete;
+
+      bool open();
+      void closed();
+
+   private:
+      /** The shm:// address, for logging. */
+      std::string address;
+      /** Name of the ring. */
+      std::string name;
+      /** The ring, when open. */
+      std::unique_ptr<SharedMemoryRing> ring;
+      /** Packages waiting for the ring to be opened. */
+      std::deque<std::string> frames;
+      /** When the ring may be tried to be opened again. */
+      std::chrono::steady_clock::time_point nextAttempt;
+      /** Set when the writer is stopped. */
+      std::atomic<bool> interrupted;
+
+      /** Logging tag. */
+      static const std::string TAG;
+   };
+
+} //namespace
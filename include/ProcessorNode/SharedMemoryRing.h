@@ -0,0 +1,85 @@
+//
+//  SharedMemoryRing.h
+//  ProcessorNode
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace OHARBase {
+
+   /**
+    SharedMemoryRing is a single producer, single consumer ring buffer in shared memory, used for
+    sending packages between nodes running on the same host without the network stack. The ring
+    lives in a memory mapped file under /dev/shm, named after the shm:// address of the receiving node.<p>
+    The consumer (the NetworkReader of the receiving node) creates the ring, and the producer (the
+    NetworkWriter of the sending node) opens it. Only one node may send to a ring. Each record is the
+    length of the serialized package followed by the package bytes. The consumer reads the records
+    in place from the shared memory, without copying them.<p>
+    A waiting consumer is woken up with a futex when records are written, and a producer waiting
+    for space when records are consumed, so neither side spins. Supported only in Linux.
+    */
+   class SharedMemoryRing {
+   public:
+      /** Which side of the ring this object is. */
+      enum Role {
+         Consumer, /*!< Creates the ring and reads records from it. */
+         Producer /*!< Opens an existing ring and writes records to it. */
+      };
+      /** A record read from the ring, pointing to the shared memory. */
+      struct Record {
+         /** The record bytes. */
+         const char * data;
+         /** Length of the record. */
+         std::size_t length;
+      };
+      /** Default size of the ring data area in bytes. */
+      static const std::size_t DefaultCapacity = 4 * 1024 * 1024;
+
+      SharedMemoryRing(const std::string & name, Role role, std::size_t capacity = DefaultCapacity);
+      ~SharedMemoryRing();
+
+      // Producer
+      bool write(const char * data, std::size_t length, const std::atomic<bool> & interrupted);
+      void notifyConsumer();
+      bool isClosed() const;
+      std::size_t maxRecordSize() const;
+
+      // Consumer
+      bool waitForRecords(std::chrono::milliseconds timeout);
+      std::size_t peek(std::vector<Record> & records);
+      void consume();
+
+   private:
+      SharedMemoryRing() = delete;
+      SharedMemoryRing(const SharedMemoryRing &) = delete;
+      const SharedMemoryRing & operator =(const SharedMemoryRing &) = delete;
+
+      struct Header;
+
+   private:
+      /** Name of the shared memory object. */
+      std::string path;
+      /** Which side of the ring this is. */
+      Role role;
+      /** Size of the mapping. */
+      std::size_t mappedSize;
+      /** The header at the start of the mapping. */
+      Header * header;
+      /** The ring data area following the header. */
+      char * ring;
+      /** Size of the ring data area, a power of two. */
+      std::size_t capacity;
+      /** Consumer: the read position after the records returned by peek(). */
+      std::uint64_t peekedTail;
+
+      /** Logging tag. */
+      static const std::string TAG;
+   };
+
+} //namespace
@@ -0,0 +1,110 @@
+//
+//  StreamConnection.h
+//  ProcessorNode
+//
+
+#pragma once
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <functional>
+
+#include <boost/asio.hpp>
+
+#include <ProcessorNode/OutputConnection.h>
+
+namespace OHARBase {
+
+   /**
+    StreamConnection is a persistent TCP connection to the next node, used by the NetworkWriter
+    for destinations given as <code>tcp://host:port</code>. Each package is sent as a frame: the length
+    of the serialized package (4 bytes, network byte order) followed by the package bytes.<p>
+    Frames are queued with queue() and handed with flush() to a thread of the connection, which writes
+    the frames waiting with one gathering write. Connecting and writing do not block the writer thread,
+    so a slow or unreachable receiver does not delay the other destinations. The frames waiting are limited,
+    and when the connection is full (see isFull()), the writer takes no more data packages until the
+    receiver has read some, so a receiver which cannot keep up slows the sender down through the TCP
+    flow control. If the connection cannot be opened or it breaks, the frames are kept (up to a limit)
+    and the connection is opened again with an exponentially growing backoff. Frames written to the
+    socket before the connection broke are not resent.
+    @see StreamListener
+    */
+   class StreamConnection : public OutputConnection {
+   public:
+      StreamConnection(const std::string & hostName, int portNumber, std::function<void()> drained = nullptr);
+      ~StreamConnection();
+
+      const std::string & getAddress() const override;
+
+      void queue(const std::string & data) override;
+      void flush() override;
+      void interrupt() override;
+      void close();
+
+      bool hasPendingFrames() const override;
+      bool isFull() const override;
+      bool isConnected() const;
+      std::chrono::steady_clock::time_point nextConnectAttempt() const override;
+
+   private:
+      StreamConnection() = delete;
+      StreamConnection(const StreamConnection &) = delete;
+      const StreamConnection & operator =(const StreamConnection &) = delete;
+
+      void enqueue(std::vector<std::string> && newFrames);
+      void connect();
+      void write();
+      void written(std::size_t count, std::size_t bytes);
+      void disconnected(const boost::system::error_code & error);
+
+   private:
+      /** The address of the receiver in host:port format, for logging. */
+      std::string address;
+      /** The endpoint of the receiver. */
+      boost::asio::ip::tcp::endpoint endpoint;
+      /** The io context of the connection, run by its thread. The socket and the timers are used only there. */
+      boost::asio::io_context context;
+      /** Keeps the thread running while there is nothing to do. */
+      boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work;
+      /** The socket connected to the receiver. */
+      boost::asio::ip::tcp::socket socket;
+      /** Times out connecting. */
+      boost::asio::steady_timer connectTimer;
+      /** Waits for the backoff before the next connection attempt. */
+      boost::asio::steady_timer retryTimer;
+      /** Frames queued by the writer thread, not yet flushed. Used by the writer thread only. */
+      std::vector<std::string> batch;
+      /** Frames waiting to be written, including the length prefix. Used by the thread of the connection only. */
+      std::deque<std::string> frames;
+      /** The buffers of the frames being written. */
+      std::vector<boost::asio::const_buffer> buffers;
+      /** True when the socket is connected. */
+      std::atomic<bool> connected;
+      /** True while connecting. */
+      bool connecting;
+      /** True while waiting for the backoff to pass. */
+      bool retrying;
+      /** True while a write is in progress. */
+      bool writing;
+      /** True when the writer is stopped and the connection is not opened again. */
+      bool stopped;
+      /** Frames flushed by the writer thread and not yet written or dropped. */
+      std::atomic<std::size_t> pendingFrames;
+      /** Bytes of the frames flushed and not yet written or dropped. */
+      std::atomic<std::size_t> pendingBytes;
+      /** How long to wait before the next connection attempt. */
+      std::chrono::milliseconds backoff;
+      /** Called by the thread of the connection when it is no longer full. */
+      std::function<void()> drained;
+      /** The thread running the io context. */
+      std::thread thread;
+
+      /** Logging tag. */
+      static const std::string TAG;
+   };
+
+} //namespace
@@ -0,0 +1,70 @@
+//
+//  StreamListener.h
+//  ProcessorNode
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <functional>
+
+#include <boost/asio.hpp>
+
+namespace OHARBase {
+
+   /**
+    StreamListener accepts TCP connections from the previous nodes and reads length-prefixed
+    frames (see StreamConnection) from them. The frames read from a connection in one read are
+    given to the frame handler together. Used by the NetworkReader for inputs given as
+    <code>tcp://port</code>. A connection sending a frame larger than the maximum frame size is closed,
+    since the stream cannot be resynchronized after that.
+    @see StreamConnection
+    */
+   class StreamListener {
+   public:
+      /** The function handling the frames received from a connection. */
+      using FrameHandler = std::function<void(std::vector<std::string> & frames, const boost::asio::ip::tcp::endpoint & from)>;
+
+      StreamListener(boost::asio::io_service & io_s, FrameHandler handler);
+      ~StreamListener();
+
+      void start(int port);
+      void stop();
+
+      void setMaxFrameSize(std::size_t size);
+      std::size_t connectionCount();
+
+   private:
+      StreamListener() = delete;
+      StreamListener(const StreamListener &) = delete;
+      const StreamListener & operator =(const StreamListener &) = delete;
+
+      class Session;
+
+      void accept();
+      void handleAccept(const boost::system::error_code & error);
+      void remove(const std::shared_ptr<Session> & session);
+
+   private:
+      /** The acceptor listening for new connections. */
+      boost::asio::ip::tcp::acceptor acceptor;
+      /** The socket for the connection being accepted. */
+      boost::asio::ip::tcp::socket incoming;
+      /** Handles the frames received. */
+      FrameHandler handler;
+      /** The open connections. */
+      std::set<std::shared_ptr<Session>> sessions;
+      /** Guards the sessions, since the listener is stopped from another thread. */
+      std::mutex guard;
+      /** Maximum length of a frame. */
+      std::size_t maxFrameSize;
+
+      /** Logging tag. */
+      static const std::string TAG;
+   };
+
+} //namespace
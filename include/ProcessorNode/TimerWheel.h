@@ -0,0 +1,73 @@
+//
+//  TimerWheel.h
+//  ProcessorNode
+//
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace OHARBase {
+
+   /**
+    TimerWheel is a hierarchical timer wheel holding a large number of deadlines, each identified
+    by a 64 bit id. Scheduling a deadline takes constant time, and advancing the wheel costs only
+    the expired deadlines plus moving the far deadlines down a level now and then.<p>
+    Time is counted in ticks. The wheel has four levels of 64 slots each: the first level holds the
+    deadlines within the next 64 ticks, each of the following levels 64 times longer periods.
+    Deadlines are expired at the latest one tick late. Deadlines cannot be cancelled; the owner
+    of the ids is expected to ignore expired ids it has no use for any more.
+    */
+   class TimerWheel {
+   public:
+      TimerWheel(std::chrono::milliseconds tickLength, std::chrono::steady_clock::time_point now);
+
+      void schedule(std::uint64_t id, std::chrono::steady_clock::time_point deadline);
+      void advance(std::chrono::steady_clock::time_point now, std::vector<std::uint64_t> & expired);
+      std::chrono::steady_clock::time_point nextDeadline() const;
+
+      std::size_t size() const;
+      bool isEmpty() const;
+      void clear();
+
+   private:
+      TimerWheel() = delete;
+
+      /** A scheduled deadline. */
+      struct Timer {
+         /** The id given when scheduling. */
+         std::uint64_t id;
+         /** The tick the deadline expires at. */
+         std::uint64_t tick;
+      };
+
+      void place(const Timer & timer);
+      std::uint64_t tickOf(std::chrono::steady_clock::time_point time) const;
+      std::chrono::steady_clock::time_point timeOf(std::uint64_t tick) const;
+
+   private:
+      /** Number of levels in the wheel. */
+      static const int Levels = 4;
+      /** Number of bits of the tick used to index the slots of a level. */
+      static const int SlotBits = 6;
+      /** Number of slots in a level. */
+      static const std::uint64_t Slots = 1 << SlotBits;
+
+      /** Length of a tick. */
+      std::chrono::steady_clock::duration tickLength;
+      /** The time of tick zero. */
+      std::chrono::steady_clock::time_point origin;
+      /** The tick the wheel has been advanced to. */
+      std::uint64_t currentTick;
+      /** The slots of each level. */
+      std::array<std::array<std::vector<Timer>, Slots>, Levels> wheel;
+      /** Deadlines scheduled in the past, expired in the next advance. */
+      std::vector<std::uint64_t> due;
+      /** Number of deadlines in the wheel. */
+      std::size_t count;
+   };
+
+} //namespace
@@ -0,0 +1,47 @@
+//
+//  UuidGenerator.h
+//  ProcessorNode
+//
+
+#pragma once
+
+#include <string>
+#include <atomic>
+
+#include <boost/uuid/uuid.hpp>
+
+namespace OHARBase {
+
+   /**
+    UuidGenerator generates the uuids of new packages. Each thread has a random number generator of its
+    own, seeded once from the entropy of the operating system, so generating a uuid needs no system call
+    nor locking. The uuids are either random (version 4), or time-ordered (version 7): the first 48 bits
+    are the time in milliseconds since the Unix epoch, followed by a counter keeping the uuids generated
+    in one thread in order within a millisecond, and 62 random bits. Time-ordered uuids sort by the
+    time the package was created, which keeps indexes and logs keyed by the uuid in order.<p>
+    The version is the same for all the nodes of the process.
+    */
+   class UuidGenerator {
+   public:
+      /** The version of the uuids generated. */
+      enum class Version {
+         Random, /*!< Random uuids, version 4, the default. */
+         TimeOrdered /*!< Time-ordered uuids, version 7. */
+      };
+
+      static boost::uuids::uuid generate();
+
+      static void setVersion(Version uuidVersion);
+      static Version getVersion();
+      static Version versionFrom(const std::string & name);
+
+   private:
+      UuidGenerator() = delete;
+
+      static boost::uuids::uuid timeOrdered();
+
+      /** The version of the uuids generated. */
+      static std::atomic<Version> version;
+   };
+
+} //namespace